@@ -1,5 +1,7 @@
 #include "Camera.h"
 
+#include <algorithm>
+
 Camera::Camera(glm::dvec3 position, glm::dvec3 up, double yaw, double pitch) : Front(glm::dvec3(1.0, 0.0, 0.0)), MovementSpeed(DEFAULT_SPEED), MouseSensitivity(DEFAULT_SENSITIVITY), FOV(DEFAULT_FOV), height(DEFAULT_HEIGHT)
 {
     Position = position;
@@ -7,6 +9,8 @@ Camera::Camera(glm::dvec3 position, glm::dvec3 up, double yaw, double pitch) : F
     Yaw = yaw;
     Pitch = pitch;
     sprint = false;
+    Velocity = glm::dvec3(0.0);
+    moved = glm::dvec3(0.0);
     updateCameraVectors();
 }
 
@@ -17,6 +21,8 @@ Camera::Camera(double posX, double posY, double posZ, double upX, double upY, do
     Yaw = yaw;
     Pitch = pitch;
     sprint = false;
+    Velocity = glm::dvec3(0.0);
+    moved = glm::dvec3(0.0);
     updateCameraVectors();
 }
 
@@ -33,6 +39,7 @@ void Camera::ProcessKeyboard(Camera_Movement direction, double deltaTime, bool F
     glm::dvec3 myFront = Front;
 
     double prevY = Position.y;
+    glm::dvec3 before = Position;
 
     // Full speed front movement, regardless of how high you look
     if (FPS)
@@ -54,6 +61,19 @@ void Camera::ProcessKeyboard(Camera_Movement direction, double deltaTime, bool F
 
     if (FPS)
         Position.y = prevY;
+
+    moved += Position - before;
+}
+
+void Camera::UpdateVelocity(double deltaTime)
+{
+    if (deltaTime <= 0)
+        return;
+
+    // Average over about a quarter second, so single frames of key repeat don't make it jitter
+    double blend = std::min(1.0, deltaTime / 0.25);
+    Velocity += (moved / deltaTime - Velocity) * blend;
+    moved = glm::dvec3(0.0);
 }
 
 void Camera::ProcessMouseMovement(double xoffset, double yoffset, GLboolean constrainPitch)
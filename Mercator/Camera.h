@@ -40,6 +40,8 @@ public:
     double FOV;
     bool sprint;
     double height;
+    // Smoothed change of Position per second from ProcessKeyboard, updated once a frame by UpdateVelocity()
+    glm::dvec3 Velocity;
 
     // Constructor that takes vectors
     Camera(glm::dvec3 position = glm::dvec3(0.0, 0.0, 0.0), glm::dvec3 up = glm::dvec3(0.0, 1.0, 0.0), double yaw = DEFAULT_YAW, double pitch = DEFAULT_PITCH);
@@ -49,6 +51,8 @@ public:
     glm::mat4 GetViewMatrix();
     // Updates camera position on input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
     void ProcessKeyboard(Camera_Movement direction, double deltaTime, bool FPS = false);
+    // Turns the movement from this frame's ProcessKeyboard calls into Velocity. Call once per frame.
+    void UpdateVelocity(double deltaTime);
     // Updates Euler Angles (Yaw/Pitch) on input received from mouse movement, then updates camera.
     void ProcessMouseMovement(double xoffset, double yoffset, GLboolean constrainPitch = true);
     // Updates FOV on input received from a mouse scrolling. Only requires input on the vertical wheel-axis.
@@ -58,6 +62,8 @@ public:
     // Move normally when shift key not held down
     void EndSprint();
 private:
+    glm::dvec3 moved; // Position change from ProcessKeyboard since the last UpdateVelocity()
+
     // Updates Front/Right/Up camera vectors from the Euler Angles (Yaw/Pitch/Roll)
     void updateCameraVectors();
 };
@@ -0,0 +1,87 @@
+#ifndef COMPLETIONQUEUE_H
+#define COMPLETIONQUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <utility>
+
+/* Multi-producer, single-consumer queue for handing finished work to the render thread.
+* Producers push onto a lock-free list with one compare-and-swap. The consumer takes the whole list with one
+* exchange, so neither side ever waits on the other, and keeps what it took in a private FIFO that it works
+* through at its own pace. Only one thread may call the consumer methods. */
+
+template <class T>
+class CompletionQueue
+{
+public:
+    CompletionQueue() : head(nullptr) {}
+
+    ~CompletionQueue() {
+        Node* node = head.load();
+        while (node != nullptr) {
+            Node* next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+
+    CompletionQueue(const CompletionQueue&) = delete;
+    CompletionQueue& operator=(const CompletionQueue&) = delete;
+
+    // Any thread
+    void push(T value) {
+        Node* node = new Node{ std::move(value), head.load(std::memory_order_relaxed) };
+        while (!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {}
+    }
+
+    // Consumer: call apply on the oldest items until budget seconds have passed, at least once if anything is
+    // ready. Items left over stay first in line for the next call. Returns how many were applied.
+    template <class F>
+    size_t consume(F apply, double budget) {
+        collect();
+        auto start = std::chrono::steady_clock::now();
+        size_t count = 0;
+        while (!ready.empty()) {
+            apply(ready.front());
+            ready.pop_front();
+            count++;
+            if (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() >= budget)
+                break;
+        }
+        return count;
+    }
+
+    // Consumer: items pushed but not yet applied, as of the last collect
+    size_t backlog() const { return ready.size(); }
+
+private:
+    struct Node
+    {
+        T value;
+        Node* next;
+    };
+
+    std::atomic<Node*> head; // Newest first
+    std::deque<T> ready; // Consumer side, oldest first
+
+    // Move everything pushed so far into ready, in push order
+    void collect() {
+        Node* node = head.exchange(nullptr, std::memory_order_acquire);
+        Node* reversed = nullptr;
+        while (node != nullptr) {
+            Node* next = node->next;
+            node->next = reversed;
+            reversed = node;
+            node = next;
+        }
+        while (reversed != nullptr) {
+            Node* next = reversed->next;
+            ready.push_back(std::move(reversed->value));
+            delete reversed;
+            reversed = next;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,187 @@
+#include "CoxeterTiling.h"
+
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+static bool shortlexLess(const std::string& a, const std::string& b) {
+    if (a.size() != b.size())
+        return a.size() < b.size();
+    return a < b;
+}
+
+bool RewriteSystem::complete(const std::vector<std::string>& relators, size_t maxRules) {
+    rules.clear();
+    std::vector<std::pair<std::string, std::string>> pending; // Equations still to be turned into rules
+    for (const std::string& r : relators)
+        pending.push_back(std::make_pair(r, std::string()));
+
+    while (true) {
+        while (!pending.empty()) {
+            std::string a = reduce(pending.back().first);
+            std::string b = reduce(pending.back().second);
+            pending.pop_back();
+            if (a == b)
+                continue;
+            if (shortlexLess(a, b))
+                std::swap(a, b);
+
+            // Keep the rules interreduced: rules whose left side contains the new one go back to pending
+            std::vector<Rule> kept;
+            for (const Rule& r : rules) {
+                if (r.lhs.find(a) != std::string::npos)
+                    pending.push_back(std::make_pair(r.lhs, r.rhs));
+                else
+                    kept.push_back(r);
+            }
+            Rule rule = { a, b };
+            kept.push_back(rule);
+            rules.swap(kept);
+            for (Rule& r : rules)
+                r.rhs = reduce(r.rhs);
+
+            if (rules.size() > maxRules)
+                return false;
+        }
+
+        // Critical pairs: a word where the end of one left side overlaps the start of another can be rewritten
+        // two ways. The rules are confluent once every such pair reduces to the same word.
+        for (const Rule& r1 : rules) {
+            for (const Rule& r2 : rules) {
+                size_t most = std::min(r1.lhs.size(), r2.lhs.size());
+                for (size_t o = 1; o < most; o++) {
+                    if (r1.lhs.compare(r1.lhs.size() - o, o, r2.lhs, 0, o) != 0)
+                        continue;
+                    std::string a = reduce(r1.rhs + r2.lhs.substr(o));
+                    std::string b = reduce(r1.lhs.substr(0, r1.lhs.size() - o) + r2.rhs);
+                    if (a != b)
+                        pending.push_back(std::make_pair(a, b));
+                }
+            }
+        }
+        if (pending.empty())
+            return true;
+    }
+}
+
+std::string RewriteSystem::reduce(const std::string& word) const {
+    // out stays irreducible, so after each letter only its suffixes need checking
+    std::string out;
+    std::string in(word.rbegin(), word.rend()); // Letters still to read, next one last
+    while (!in.empty()) {
+        out.push_back(in.back());
+        in.pop_back();
+        for (const Rule& r : rules) {
+            if (out.size() >= r.lhs.size() && out.compare(out.size() - r.lhs.size(), r.lhs.size(), r.lhs) == 0) {
+                out.resize(out.size() - r.lhs.size());
+                in.append(r.rhs.rbegin(), r.rhs.rend());
+                break;
+            }
+        }
+    }
+    return out;
+}
+
+/*********************************************************************/
+
+CoxeterTiling::CoxeterTiling(int n, int k) : n(n), k(k) {
+    assert(n <= MAX_N && k <= MAX_K);
+    assert((n - 2) * (k - 2) > 4); // Hyperbolic
+
+    std::string r01, r12;
+    for (int i = 0; i < n; i++)
+        r01 += "01";
+    for (int i = 0; i < k; i++)
+        r12 += "12";
+    if (!system.complete({ "00", "11", "22", r01, r12, "0202" }))
+        std::cout << "KNUTH-BENDIX DID NOT FINISH FOR {" << n << "," << k << "}" << std::endl;
+
+    // Fundamental triangle: origin tile center (angle pi/n), first edge midpoint at angle pi/n from the x-axis
+    // (right angle), first vertex on the x-axis (angle pi/k)
+    double a = M_PI / n;
+    double inradius = acosh(cos(M_PI / k) / sin(a));
+    double circumradius = acosh(1 / (tan(a) * tan(M_PI / k)));
+    generators[0] = Isometry::reflection(glm::dvec3(-sin(a), 0, cos(a)));
+    generators[1] = Isometry::reflection(glm::dvec3(0, 0, 1));
+    generators[2] = Isometry::reflection(glm::dvec3(cosh(inradius) * cos(a), sinh(inradius), cosh(inradius) * sin(a)));
+
+    // r0 r1 turns the origin tile by one vertex, CCW
+    glm::dvec3 first = glm::dvec3(sinh(circumradius), cosh(circumradius), 0);
+    for (int i = 0; i < n; i++)
+        corners[i] = Isometry::rotate(2 * a * i) * first;
+
+    find("");
+}
+
+std::string CoxeterTiling::cosetWord(std::string w, std::string& stripped) const {
+    // The shortest word in a coset has no letter of the subgroup that can come off its end
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (char s : { '0', '1' }) {
+            std::string shorter = system.reduce(w + s);
+            if (shorter.size() < w.size()) {
+                w = shorter;
+                stripped += s;
+                changed = true;
+            }
+        }
+    }
+    return w;
+}
+
+TileId CoxeterTiling::find(const std::string& word) {
+    std::string stripped;
+    std::string w = cosetWord(system.reduce(word), stripped);
+    auto it = index.find(w);
+    if (it != index.end())
+        return it->second;
+
+    WordTile tile;
+    tile.word = w;
+    for (char c : w)
+        tile.transform = tile.transform * generators[c - '0'];
+    tile.neighbors.fill(NO_ID);
+
+    TileId id = (TileId)tiles.size();
+    tiles.push_back(tile);
+    index[w] = id;
+    return id;
+}
+
+TileId CoxeterTiling::neighbor(TileId t, int i) {
+    if (tiles[t].neighbors[i] != NO_ID)
+        return tiles[t].neighbors[i];
+
+    // Edge j of the tile's own frame; across it is the image of the origin tile's neighbor across edge 0
+    int j = mirrored(t) ? (2 * n - i - 1) % n : i;
+    std::string w = tiles[t].word;
+    for (int m = 0; m < j; m++)
+        w += "01";
+    w += '2';
+
+    std::string stripped;
+    w = cosetWord(system.reduce(w), stripped);
+    TileId other = find(w);
+
+    // The letters stripped to reach the other tile's word move its edge back to t around its center:
+    // r0 maps edge e to -e, and r1 maps it to -e - 1
+    int e = 0;
+    for (char s : stripped)
+        e = (s == '0') ? (n - e) % n : (2 * n - e - 1) % n;
+    int back = mirrored(other) ? (2 * n - e - 1) % n : e;
+
+    tiles[t].neighbors[i] = other;
+    assert(tiles[other].neighbors[back] == NO_ID || tiles[other].neighbors[back] == t);
+    tiles[other].neighbors[back] = t;
+    return other;
+}
+
+glm::dvec3 CoxeterTiling::center(TileId t) const {
+    return tiles[t].transform * glm::dvec3(0, 1, 0);
+}
+
+glm::dvec3 CoxeterTiling::vertex(TileId t, int i) const {
+    int j = mirrored(t) ? (n - i) % n : i;
+    return tiles[t].transform * corners[j];
+}
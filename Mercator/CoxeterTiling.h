@@ -0,0 +1,79 @@
+#ifndef COXETERTILING_H
+#define COXETERTILING_H
+
+#include "hyper.h"
+#include "Vertex.h"
+#include <array>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+/* Confluent rewriting system for a group given by generators and relators, built with Knuth-Bendix
+* completion under the shortlex order. Once complete, reduce() maps a word to the shortlex-least word for
+* the same group element, so two words are equal in the group exactly when they reduce to the same word. */
+
+class RewriteSystem
+{
+public:
+    struct Rule
+    {
+        std::string lhs;
+        std::string rhs; // Shortlex-less than lhs
+    };
+
+    std::vector<Rule> rules;
+
+    // Complete the rules for the given relators (words equal to the identity).
+    // Returns false if the rules grow past maxRules without becoming confluent.
+    bool complete(const std::vector<std::string>& relators, size_t maxRules = 1000);
+
+    std::string reduce(const std::string& word) const;
+};
+
+/* Alternative tiling engine that finds tile topology from the symmetry group instead of from geometry.
+* The symmetries of the {n,k} tiling form the Coxeter triangle group generated by the reflections r0, r1, r2,
+* with (r0 r1)^n = (r1 r2)^k = (r0 r2)^2 = 1. r0 and r1 fix the center of the origin tile, r1 and r2 fix its
+* first vertex, and r2 maps it onto its neighbor across its first edge.
+* A tile is a coset w<r0,r1>, named by the shortest word in it. Neighbors are found by appending letters and
+* rewriting, so adjacency is exact and never depends on vertex positions. Positions come from the product of
+* the generator reflections along the tile's word. */
+
+class CoxeterTiling
+{
+public:
+    struct WordTile
+    {
+        std::string word; // Shortest word of the coset, over the letters '0', '1', '2'
+        Isometry transform; // Product of the generators along word; maps the origin tile onto this one
+        std::array<TileId, MAX_N> neighbors; // Across each edge, CCW order. NO_ID until first looked up.
+    };
+
+    int n; // Number of vertices per tile
+    int k; // Number of tiles per vertex
+    RewriteSystem system;
+    std::vector<WordTile> tiles; // tiles[0] is the origin tile
+    Isometry generators[3]; // Reflections r0, r1, r2
+
+    CoxeterTiling(int n, int k);
+
+    // Tile containing the group element named by word, created if it doesn't exist yet
+    TileId find(const std::string& word);
+
+    // Tile across edge i (CCW order, edge i runs from vertex i to vertex i + 1). Cached after the first call.
+    TileId neighbor(TileId t, int i);
+
+    glm::dvec3 center(TileId t) const;
+    glm::dvec3 vertex(TileId t, int i) const; // CCW order, vertex 0 is on the x-axis for the origin tile
+
+private:
+    std::unordered_map<std::string, TileId> index; // Tile by word
+    std::array<glm::dvec3, MAX_N> corners; // Vertices of the origin tile, CCW
+
+    // Shortest word in w<r0,r1>, for a reduced w. Appends the letters it strips off w to stripped.
+    std::string cosetWord(std::string w, std::string& stripped) const;
+
+    // Tiles with odd-length words are mirror images, so their own vertex order runs clockwise
+    bool mirrored(TileId t) const { return tiles[t].word.size() % 2 == 1; }
+};
+
+#endif
@@ -0,0 +1,111 @@
+/* Standalone check for CoxeterTiling. For a few {n,k} it walks every tile within a few steps of the origin and
+* checks that adjacency and geometry agree: every neighbor has a back edge to the tile, neighbors share both
+* vertices of that edge, neighbor centers are twice the inradius apart, every tile has the same vertex order
+* as the origin tile, and no two tiles have the same center. Prints one line per tiling and exits non-zero if
+* any check fails.
+*
+* Build and run from this directory:
+*   g++ -IOpenGL/includes CoxeterTilingCheck.cpp CoxeterTiling.cpp -o coxeter_check && ./coxeter_check
+*/
+
+#include "CoxeterTiling.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+static const double EPS = 1e-6;
+
+static bool near(glm::dvec3 a, glm::dvec3 b)
+{
+    glm::dvec3 d = a - b;
+    return glm::dot(d, d) < EPS * EPS * glm::dot(a, a);
+}
+
+// Sign of the turn from vertex 0 to vertex 1 around the center, in the Beltrami-Klein projection
+static double winding(const CoxeterTiling& tiling, TileId t)
+{
+    glm::dvec3 c = getBeltrami(tiling.center(t));
+    glm::dvec3 a = getBeltrami(tiling.vertex(t, 0)) - c;
+    glm::dvec3 b = getBeltrami(tiling.vertex(t, 1)) - c;
+    return a.x * b.z - a.z * b.x;
+}
+
+// Returns the number of failed checks
+static int check(int n, int k, int depth)
+{
+    CoxeterTiling tiling(n, k);
+    int failures = 0;
+    auto fail = [&](TileId t, const char* what) {
+        if (failures++ < 5)
+            std::cout << "  {" << n << "," << k << "} tile \"" << tiling.tiles[t].word << "\": " << what << std::endl;
+    };
+
+    double inradius = acosh(cos(M_PI / k) / sin(M_PI / n));
+    if (!near(tiling.vertex(0, 0), reversePoincare(circleRadius(n, k), 0)))
+        fail(0, "first vertex is not where Tile::setStart puts it");
+    double originWinding = winding(tiling, 0);
+
+    // Breadth-first over tiles, one ring per step
+    std::vector<TileId> ring = { 0 };
+    std::vector<char> seen(1, 1);
+    std::vector<TileId> all = { 0 };
+    for (int step = 0; step < depth; step++) {
+        std::vector<TileId> next;
+        for (TileId t : ring) {
+            for (int i = 0; i < n; i++) {
+                TileId other = tiling.neighbor(t, i);
+                if (other >= seen.size())
+                    seen.resize(other + 1, 0);
+                if (!seen[other]) {
+                    seen[other] = 1;
+                    next.push_back(other);
+                    all.push_back(other);
+                }
+
+                int back = -1;
+                for (int j = 0; j < n; j++)
+                    if (tiling.neighbor(other, j) == t)
+                        back = j;
+                if (back < 0) {
+                    fail(t, "neighbor has no edge back");
+                    continue;
+                }
+                if (!near(tiling.vertex(t, i), tiling.vertex(other, (back + 1) % n)) ||
+                    !near(tiling.vertex(t, (i + 1) % n), tiling.vertex(other, back)))
+                    fail(t, "neighbors do not share the edge's vertices");
+                if (abs(dist(tiling.center(t), tiling.center(other)) - 2 * inradius) > EPS)
+                    fail(t, "neighbor center is not twice the inradius away");
+            }
+            if (winding(tiling, t) * originWinding <= 0)
+                fail(t, "vertex order differs from the origin tile");
+        }
+        ring.swap(next);
+    }
+
+    // Sort by x so only centers with nearly the same x need comparing
+    std::vector<std::pair<double, TileId>> byX;
+    for (TileId t : all)
+        byX.push_back(std::make_pair(tiling.center(t).x, t));
+    std::sort(byX.begin(), byX.end());
+    for (size_t a = 0; a < byX.size(); a++)
+        for (size_t b = a + 1; b < byX.size() && byX[b].first - byX[a].first < EPS * (1 + abs(byX[a].first)); b++)
+            if (near(tiling.center(byX[a].second), tiling.center(byX[b].second)))
+                fail(byX[b].second, "same center as another tile");
+
+    std::cout << "{" << n << "," << k << "} depth " << depth << ": " << all.size() << " tiles, "
+              << (failures ? std::to_string(failures) + " FAILED" : std::string("ok")) << std::endl;
+    return failures;
+}
+
+int main()
+{
+    const int tilings[][3] = {
+        { 4, 5, 7 }, { 5, 4, 7 }, { 3, 7, 8 }, { 7, 3, 6 }, { 4, 6, 6 },
+        { 6, 4, 6 }, { 5, 5, 6 }, { 8, 3, 6 }, { 3, 8, 7 },
+    };
+    int failures = 0;
+    for (const auto& t : tilings)
+        failures += check(t[0], t[1], t[2]);
+    return failures ? 1 : 0;
+}
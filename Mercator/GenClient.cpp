@@ -0,0 +1,444 @@
+#include "GenClient.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+#include <chrono>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "Ws2_32.lib")
+#endif
+static const SocketHandle NO_SOCKET = (SocketHandle)INVALID_SOCKET;
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+static const SocketHandle NO_SOCKET = -1;
+#endif
+
+#ifdef _WIN32
+// Winsock has to be started once per process
+static void startSockets() {
+    static bool started = false;
+    if (!started) {
+        WSADATA data;
+        WSAStartup(MAKEWORD(2, 2), &data);
+        started = true;
+    }
+}
+#endif
+
+HttpConnection::HttpConnection(const std::string& host, int port) : host(host), port(port) {
+    sock = NO_SOCKET;
+    connected = false;
+    aborted = false;
+#ifdef _WIN32
+    startSockets();
+#endif
+}
+
+HttpConnection::~HttpConnection() {
+    close();
+}
+
+bool HttpConnection::open(std::string& error) {
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = NULL;
+    if (aborted) {
+        error = "aborted";
+        return false;
+    }
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0) {
+        error = "could not resolve " + host;
+        return false;
+    }
+
+    for (addrinfo* a = addresses; a != NULL; a = a->ai_next) {
+        SocketHandle s = (SocketHandle)socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (s == NO_SOCKET)
+            continue;
+        if (connect(s, a->ai_addr, (int)a->ai_addrlen) == 0) {
+            // Requests are written in one piece and waited on, so don't let Nagle hold back the last segment
+            int on = 1;
+            setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on));
+            std::lock_guard<std::mutex> lock(sockMutex);
+            if (!aborted) {
+                sock = s;
+                break;
+            }
+        }
+#ifdef _WIN32
+        closesocket(s);
+#else
+        ::close(s);
+#endif
+    }
+    freeaddrinfo(addresses);
+
+    if (sock == NO_SOCKET) {
+        error = "could not connect to " + host + ":" + std::to_string(port);
+        return false;
+    }
+    connected = true;
+    buffer.clear();
+    return true;
+}
+
+void HttpConnection::close() {
+    std::lock_guard<std::mutex> lock(sockMutex);
+    if (sock != NO_SOCKET) {
+#ifdef _WIN32
+        closesocket(sock);
+#else
+        ::close(sock);
+#endif
+    }
+    sock = NO_SOCKET;
+    connected = false;
+    buffer.clear();
+}
+
+void HttpConnection::abort() {
+    std::lock_guard<std::mutex> lock(sockMutex);
+    aborted = true;
+    if (sock != NO_SOCKET) {
+#ifdef _WIN32
+        shutdown(sock, SD_BOTH);
+#else
+        shutdown(sock, SHUT_RDWR);
+#endif
+    }
+}
+
+bool HttpConnection::sendAll(const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+#ifdef _WIN32
+        int count = send(sock, data.data() + sent, (int)(data.size() - sent), 0);
+#else
+        ssize_t count = send(sock, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+#endif
+        if (count <= 0)
+            return false;
+        sent += count;
+    }
+    return true;
+}
+
+bool HttpConnection::receive() {
+    char chunk[16384];
+#ifdef _WIN32
+    int count = recv(sock, chunk, sizeof(chunk), 0);
+#else
+    ssize_t count = recv(sock, chunk, sizeof(chunk), 0);
+#endif
+    if (count <= 0)
+        return false;
+    buffer.append(chunk, count);
+    return true;
+}
+
+bool HttpConnection::closedByPeer() {
+    // Nothing is expected on an idle connection, so anything readable is a FIN or a reset
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(sock, &readable);
+    timeval timeout = { 0, 0 };
+    if (select((int)sock + 1, &readable, NULL, NULL, &timeout) <= 0)
+        return false;
+    char c;
+    return recv(sock, &c, 1, MSG_PEEK) <= 0;
+}
+
+// Case-insensitive check for a header name at the start of line
+static bool headerIs(const std::string& line, const char* name) {
+    size_t length = strlen(name);
+    if (line.size() <= length || line[length] != ':')
+        return false;
+    for (size_t i = 0; i < length; i++) {
+        if (tolower((unsigned char)line[i]) != tolower((unsigned char)name[i]))
+            return false;
+    }
+    return true;
+}
+
+static std::string headerValue(const std::string& line) {
+    size_t start = line.find(':') + 1;
+    while (start < line.size() && line[start] == ' ')
+        start++;
+    std::string value = line.substr(start);
+    for (char& c : value)
+        c = tolower((unsigned char)c);
+    return value;
+}
+
+bool HttpConnection::exchange(const std::string& message, int& status, std::string& response, bool& keepAlive, bool& sendFailed, std::string& error) {
+    sendFailed = !sendAll(message);
+    if (sendFailed) {
+        error = "send failed";
+        return false;
+    }
+
+    // Status line and headers
+    size_t end;
+    while ((end = buffer.find("\r\n\r\n")) == std::string::npos) {
+        if (!receive()) {
+            error = "connection closed before the response";
+            return false;
+        }
+    }
+    std::string head = buffer.substr(0, end);
+    buffer.erase(0, end + 4);
+
+    size_t lineEnd = head.find("\r\n");
+    std::string statusLine = head.substr(0, lineEnd);
+    if (statusLine.compare(0, 5, "HTTP/") != 0 || statusLine.size() < 12) {
+        error = "bad status line: " + statusLine;
+        return false;
+    }
+    status = atoi(statusLine.c_str() + 9);
+    keepAlive = statusLine.compare(0, 8, "HTTP/1.0") != 0;
+
+    long long contentLength = -1;
+    bool chunked = false;
+    while (lineEnd != std::string::npos) {
+        size_t start = lineEnd + 2;
+        lineEnd = head.find("\r\n", start);
+        std::string line = head.substr(start, lineEnd == std::string::npos ? std::string::npos : lineEnd - start);
+        if (headerIs(line, "Content-Length"))
+            contentLength = atoll(headerValue(line).c_str());
+        else if (headerIs(line, "Transfer-Encoding"))
+            chunked = headerValue(line).find("chunked") != std::string::npos;
+        else if (headerIs(line, "Connection"))
+            keepAlive = headerValue(line).find("close") == std::string::npos;
+    }
+
+    // Body
+    response.clear();
+    if (chunked) {
+        while (true) {
+            size_t sizeEnd;
+            while ((sizeEnd = buffer.find("\r\n")) == std::string::npos) {
+                if (!receive()) {
+                    error = "connection closed inside a chunk";
+                    return false;
+                }
+            }
+            size_t size = strtoul(buffer.c_str(), NULL, 16);
+            while (buffer.size() < sizeEnd + 2 + size + 2) {
+                if (!receive()) {
+                    error = "connection closed inside a chunk";
+                    return false;
+                }
+            }
+            response.append(buffer, sizeEnd + 2, size);
+            buffer.erase(0, sizeEnd + 2 + size + 2);
+            if (size == 0)
+                break;
+        }
+    } else if (contentLength >= 0) {
+        while ((long long)buffer.size() < contentLength) {
+            if (!receive()) {
+                error = "connection closed inside the body";
+                return false;
+            }
+        }
+        response = buffer.substr(0, contentLength);
+        buffer.erase(0, contentLength);
+    } else {
+        // No length given: the body runs until the server closes the connection
+        while (receive()) {}
+        response.swap(buffer);
+        keepAlive = false;
+    }
+    return true;
+}
+
+bool HttpConnection::request(const std::string& method, const std::string& path, const std::string& contentType,
+                             const std::string& body, int& status, std::string& response, std::string& error) {
+    std::string message = method + " " + path + " HTTP/1.1\r\n"
+                        + "Host: " + host + ":" + std::to_string(port) + "\r\n"
+                        + "Connection: keep-alive\r\n";
+    if (!body.empty() || method == "POST") {
+        message += "Content-Type: " + contentType + "\r\n";
+        message += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    }
+    message += "\r\n";
+    message += body;
+
+    if (connected && closedByPeer())
+        close();
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool reused = connected;
+        if (!connected && !open(error))
+            return false;
+
+        bool keepAlive = false;
+        bool sendFailed = false;
+        if (exchange(message, status, response, keepAlive, sendFailed, error)) {
+            if (!keepAlive)
+                close();
+            error.clear();
+            return true;
+        }
+
+        // POST /generate isn't idempotent, so only send again if the server can't have read the whole request.
+        // That happens when a kept-alive connection was closed between the check above and the send.
+        bool retry = reused && sendFailed && buffer.empty();
+        close();
+        if (!retry)
+            return false;
+    }
+    return false;
+}
+
+/*********************************************************************/
+
+const double LATENCY_TOLERANCE = 2.0; // Latency over this multiple of the base counts as congestion
+const double LATENCY_SMOOTHING = 0.2;
+
+static double now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+GenClient::GenClient(const std::string& host, int port, size_t workers) {
+    nextId = 1;
+    active = 0;
+    stopping = false;
+    limit = 1;
+    baseLatency = 0;
+    latency = 0;
+    lastDecrease = 0;
+    completed = 0;
+    failed = 0;
+    for (size_t i = 0; i < std::max<size_t>(workers, 1); i++) {
+        connections.push_back(new HttpConnection(host, port));
+        this->workers.emplace_back(&GenClient::run, this, connections.back());
+    }
+}
+
+GenClient::~GenClient() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        queue.clear();
+    }
+    wake.notify_all();
+    for (HttpConnection* c : connections)
+        c->abort();
+    for (std::thread& t : workers)
+        t.join();
+    for (HttpConnection* c : connections)
+        delete c;
+}
+
+uint64_t GenClient::submit(const GenRequest& request) {
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        id = nextId++;
+        Job job = { id, request };
+        queue.push_back(job);
+    }
+    wake.notify_one();
+    return id;
+}
+
+bool GenClient::cancel(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = queue.begin(); it != queue.end(); ++it) {
+        if (it->id == id) {
+            queue.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+GenStats GenClient::stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    GenStats s = { queue.size(), active, limit, completed, failed, latency, finished.backlog() };
+    return s;
+}
+
+void GenClient::run(HttpConnection* connection) {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || (!queue.empty() && active < (size_t)limit); });
+            if (stopping)
+                return;
+            job = queue.front();
+            queue.pop_front();
+            active++;
+        }
+
+        double start = now();
+        GenResult result = send(connection, job);
+        double seconds = now() - start;
+        bool ok = result.ok;
+        finished.push(std::move(result));
+
+        std::lock_guard<std::mutex> lock(mutex);
+        active--;
+        if (stopping)
+            return;
+        adjust(seconds, ok);
+        wake.notify_all(); // The limit may have grown, or this worker's slot is free again
+    }
+}
+
+void GenClient::adjust(double seconds, bool ok) {
+    double time = now();
+    bool congested = !ok;
+    if (ok) {
+        completed++;
+        latency = latency == 0 ? seconds : latency + LATENCY_SMOOTHING * (seconds - latency);
+
+        // Let the base drift up slowly, so a server that got slower for good isn't read as congested forever
+        baseLatency = baseLatency == 0 ? seconds : std::min(seconds, baseLatency * 1.01);
+        congested = seconds > LATENCY_TOLERANCE * baseLatency;
+    } else {
+        failed++;
+    }
+
+    if (congested) {
+        // Requests sent before the last cut report the old congestion; wait for one round trip after it
+        if (time - lastDecrease > latency) {
+            limit = std::max(1.0, limit / 2);
+            lastDecrease = time;
+        }
+    } else if (active + 1 >= (size_t)limit) {
+        // Grow only while the limit is what's holding requests back, about one step per round trip
+        limit = std::min((double)workers.size(), limit + 1 / limit);
+    }
+}
+
+GenResult GenClient::send(HttpConnection* connection, const Job& job) {
+    GenResult result;
+    int status = 0;
+    std::string body;
+    if (connection->request("POST", "/generate", GEN_CONTENT_TYPE, encodeGenRequest(job.request), status, body, result.error)) {
+        // Errors come back as frames too, with the reason in them
+        if (!decodeGenResponse(body, result) && status != 200)
+            result.error = "server returned " + std::to_string(status) + ": " + result.error;
+    } else {
+        result.ok = false;
+    }
+    result.id = job.id;
+    return result;
+}
@@ -0,0 +1,124 @@
+#ifndef GENCLIENT_H
+#define GENCLIENT_H
+
+#include "GenProtocol.h"
+#include "CompletionQueue.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+/* Client for the generation server (runserver.py).
+* A fixed pool of worker threads, each with its own HTTP/1.1 keep-alive connection, POSTs the submitted
+* requests as GenProtocol frames, so the render loop only calls submit() and collects results with complete().
+* Results come back through a lock-free CompletionQueue, so collecting them never waits on a worker.
+* How many requests are out at once adapts to the server: the limit grows by one per round trip while
+* latency stays near the best seen, and halves on errors or when latency climbs (AIMD). */
+
+#ifdef _WIN32
+typedef uintptr_t SocketHandle;
+#else
+typedef int SocketHandle;
+#endif
+
+// Blocking HTTP/1.1 connection that is kept open between requests
+class HttpConnection
+{
+public:
+    HttpConnection(const std::string& host, int port);
+    ~HttpConnection();
+
+    // Send a request and read the whole response. A kept-alive connection the server has closed is reopened
+    // before sending. The request is only sent again if writing it failed before any response came back,
+    // since the server may already be running it otherwise. Returns false with error set if no response was read.
+    bool request(const std::string& method, const std::string& path, const std::string& contentType,
+                 const std::string& body, int& status, std::string& response, std::string& error);
+
+    // Unblock a request in progress from another thread and refuse new ones
+    void abort();
+
+private:
+    std::string host;
+    int port;
+    SocketHandle sock;
+    bool connected;
+    bool aborted;
+    std::mutex sockMutex; // Guards sock against abort()
+    std::string buffer; // Bytes received but not yet parsed
+
+    bool open(std::string& error);
+    void close();
+    bool sendAll(const std::string& data);
+    bool receive(); // Append whatever arrives to buffer. False on error or if the peer closed.
+    bool closedByPeer(); // True if the idle connection was shut down or reset by the server
+    // sendFailed is set if the message could not be written
+    bool exchange(const std::string& message, int& status, std::string& response, bool& keepAlive, bool& sendFailed, std::string& error);
+};
+
+struct GenStats
+{
+    size_t queued; // Submitted, waiting for a worker
+    size_t inFlight; // Sent, waiting for the server
+    double limit; // Current in-flight limit
+    size_t completed; // Requests answered successfully so far
+    size_t failed;
+    double latency; // Smoothed seconds per request
+    size_t backlog; // Finished, not yet reached by complete()
+};
+
+class GenClient
+{
+public:
+    GenClient(const std::string& host = "127.0.0.1", int port = 5555, size_t workers = 8);
+    ~GenClient(); // Drops queued requests, cuts off the ones in flight and joins the workers
+
+    // Queue a request. Returns an id that the matching GenResult will carry.
+    uint64_t submit(const GenRequest& request);
+
+    // Render thread: call apply on finished requests, oldest first, until budget seconds have passed.
+    // Results not reached wait for the next call. Returns how many were applied.
+    template <class F>
+    size_t complete(F apply, double budget) {
+        return finished.consume(apply, budget);
+    }
+
+    // Take back a request that no worker has picked up yet. Returns false if it is already being sent.
+    bool cancel(uint64_t id);
+
+    GenStats stats(); // Render thread, like complete()
+
+private:
+    struct Job
+    {
+        uint64_t id;
+        GenRequest request;
+    };
+
+    std::vector<HttpConnection*> connections; // One per worker
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Job> queue;
+    CompletionQueue<GenResult> finished;
+    uint64_t nextId;
+    size_t active; // Requests being sent by workers
+    bool stopping;
+
+    // AIMD state, guarded by mutex
+    double limit;
+    double baseLatency; // Lowest latency seen lately; later samples are compared against it
+    double latency;
+    double lastDecrease; // Time of the last cut, so one slow round trip only cuts once
+    size_t completed;
+    size_t failed;
+
+    void run(HttpConnection* connection);
+    GenResult send(HttpConnection* connection, const Job& job);
+    void adjust(double seconds, bool ok);
+};
+
+#endif
@@ -0,0 +1,215 @@
+#include "GenProtocol.h"
+
+#include <cstring>
+
+enum
+{
+    GENERATE_REQUEST = 1,
+    GENERATE_RESPONSE = 2
+};
+
+enum
+{
+    FLAG_WORLD_LATENTS = 1,
+    FLAG_RETURN_LATENTS = 2,
+    FLAG_RETURN_IMAGES = 4,
+    FLAG_SAVE_IMAGES = 8
+};
+
+enum
+{
+    STATUS_OK = 0
+};
+
+const size_t HEADER_SIZE = 12;
+
+// Little-endian writer, independent of the host byte order
+struct FrameWriter
+{
+    std::string data;
+
+    void u16(uint16_t v) {
+        data += (char)(v & 0xff);
+        data += (char)(v >> 8);
+    }
+
+    void u32(uint32_t v) {
+        for (int i = 0; i < 4; i++)
+            data += (char)((v >> (8 * i)) & 0xff);
+    }
+
+    void u64(uint64_t v) {
+        for (int i = 0; i < 8; i++)
+            data += (char)((v >> (8 * i)) & 0xff);
+    }
+
+    void f32(float f) {
+        uint32_t v;
+        memcpy(&v, &f, sizeof(v));
+        u32(v);
+    }
+
+    void f64(double d) {
+        uint64_t v;
+        memcpy(&v, &d, sizeof(v));
+        u64(v);
+    }
+};
+
+struct FrameReader
+{
+    const unsigned char* data;
+    size_t size;
+    size_t pos;
+    bool ok; // Cleared by the first read past the end
+
+    FrameReader(const std::string& s, size_t start, size_t end)
+        : data((const unsigned char*)s.data()), size(end), pos(start), ok(true) {}
+
+    bool has(size_t bytes) {
+        if (size - pos < bytes)
+            ok = false;
+        return ok;
+    }
+
+    uint16_t u16() {
+        if (!has(2))
+            return 0;
+        uint16_t v = (uint16_t)(data[pos] | (data[pos + 1] << 8));
+        pos += 2;
+        return v;
+    }
+
+    uint32_t u32() {
+        if (!has(4))
+            return 0;
+        uint32_t v = 0;
+        for (int i = 0; i < 4; i++)
+            v |= (uint32_t)data[pos + i] << (8 * i);
+        pos += 4;
+        return v;
+    }
+
+    float f32() {
+        uint32_t v = u32();
+        float f;
+        memcpy(&f, &v, sizeof(f));
+        return f;
+    }
+};
+
+std::string encodeGenRequest(const GenRequest& request) {
+    bool latents = request.latentDim > 0 && request.worldLatents.size() == request.world.size() * request.latentDim;
+
+    FrameWriter w;
+    w.data.reserve(HEADER_SIZE + 16 + (request.world.size() + request.coords.size()) * 20 + request.worldLatents.size() * 4);
+    w.data += "MGEN";
+    w.u16(GEN_VERSION);
+    w.u16(GENERATE_REQUEST);
+    w.u32(0); // Payload length, filled in below
+
+    uint32_t flags = (latents ? FLAG_WORLD_LATENTS : 0) | (request.returnLatents ? FLAG_RETURN_LATENTS : 0);
+    if (request.imageSize > 0)
+        flags |= FLAG_RETURN_IMAGES | (request.saveImages ? FLAG_SAVE_IMAGES : 0);
+    w.u32(flags);
+    w.u32((uint32_t)request.world.size());
+    w.u32((uint32_t)request.coords.size());
+    w.u32(latents ? request.latentDim : 0);
+    for (const WorldTile& t : request.world) {
+        w.u32((uint32_t)t.index);
+        w.f64(t.x);
+        w.f64(t.z);
+    }
+    if (latents) {
+        for (float f : request.worldLatents)
+            w.f32(f);
+    }
+    for (size_t i = 0; i < request.coords.size(); i++) {
+        w.u32((uint32_t)(i < request.ids.size() ? request.ids[i] : -1));
+        w.f64(request.coords[i].x);
+        w.f64(request.coords[i].y);
+    }
+    w.u32(request.imageSize);
+    w.u32(request.imageLevels);
+
+    uint32_t length = (uint32_t)(w.data.size() - HEADER_SIZE);
+    for (int i = 0; i < 4; i++)
+        w.data[8 + i] = (char)((length >> (8 * i)) & 0xff);
+    return w.data;
+}
+
+bool decodeGenResponse(const std::string& frame, GenResult& result) {
+    result.ok = false;
+    result.ids.clear();
+    result.latents.clear();
+    result.latentDim = 0;
+    result.pixels.clear();
+    result.imageSize = 0;
+    result.imageLevels = 0;
+
+    if (frame.size() < HEADER_SIZE || frame.compare(0, 4, "MGEN") != 0) {
+        result.error = "response is not a generation frame";
+        return false;
+    }
+    FrameReader header(frame, 4, HEADER_SIZE);
+    uint16_t version = header.u16();
+    uint16_t type = header.u16();
+    uint32_t length = header.u32();
+    if (version == 0 || version > GEN_VERSION) {
+        result.error = "unsupported response version " + std::to_string(version);
+        return false;
+    }
+    if (type != GENERATE_RESPONSE || frame.size() - HEADER_SIZE < length) {
+        result.error = "malformed response frame";
+        return false;
+    }
+
+    FrameReader r(frame, HEADER_SIZE, HEADER_SIZE + length);
+    uint32_t status = r.u32();
+    uint32_t count = r.u32();
+    uint32_t latentDim = r.u32();
+    if (!r.has((size_t)count * 4 + (size_t)count * latentDim * 4)) {
+        result.error = "truncated response frame";
+        return false;
+    }
+    result.ids.resize(count);
+    for (uint32_t i = 0; i < count; i++)
+        result.ids[i] = (int)r.u32();
+    result.latentDim = latentDim;
+    result.latents.resize((size_t)count * latentDim);
+    for (float& f : result.latents)
+        f = r.f32();
+
+    uint32_t messageLength = r.u32();
+    std::string message;
+    if (r.has(messageLength)) {
+        message.assign((const char*)r.data + r.pos, messageLength);
+        r.pos += messageLength;
+    }
+
+    // Images were appended to version 1; a server that doesn't send them ends the payload here
+    if (r.ok && r.size - r.pos >= 12) {
+        uint32_t images = r.u32();
+        uint32_t size = r.u32();
+        uint32_t levels = r.u32();
+        if (images > 0 && (size == 0 || size > GEN_MAX_IMAGE_SIZE || levels == 0 || levels > GEN_MAX_IMAGE_LEVELS)) {
+            result.error = "response image size " + std::to_string(size) + " with " + std::to_string(levels) + " levels is out of range";
+            return false;
+        }
+        // Compare against what's left before multiplying, so a huge image count can't overflow
+        size_t chain = images > 0 ? genChainBytes(size, levels) : 0;
+        if (images > 0 && images == count && (r.size - r.pos) / chain >= images) {
+            size_t bytes = images * chain;
+            result.pixels.assign(r.data + r.pos, r.data + r.pos + bytes);
+            result.imageSize = size;
+            result.imageLevels = levels;
+        }
+    }
+
+    if (status != STATUS_OK) {
+        result.error = message.empty() ? "generation failed with status " + std::to_string(status) : message;
+        return false;
+    }
+    result.ok = true;
+    return true;
+}
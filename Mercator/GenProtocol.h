@@ -0,0 +1,85 @@
+#ifndef GENPROTOCOL_H
+#define GENPROTOCOL_H
+
+#include <glm/glm.hpp>
+
+#include <cassert>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/*******************
+* Binary frames exchanged with the generation server over POST /generate.
+* The layout is documented in genprotocol.py, which is the server side of this file. Frames carry a version
+* so either side can be updated first: readers accept versions up to their own and skip trailing payload
+* bytes they don't know about.
+********************/
+
+const uint16_t GEN_VERSION = 1;
+const char* const GEN_CONTENT_TYPE = "application/x-mercator-gen";
+
+// Largest image either side accepts, as in genprotocol.py. Frames asking for more are rejected.
+const unsigned int GEN_MAX_IMAGE_SIZE = 4096;
+const unsigned int GEN_MAX_IMAGE_LEVELS = 13; // Full chain of a GEN_MAX_IMAGE_SIZE image
+
+// A tile that already has a latent vector on the server
+struct WorldTile
+{
+    int index; // queueNum of the tile
+    double x;
+    double z;
+};
+
+struct GenRequest
+{
+    std::vector<WorldTile> world; // Nearby tiles to condition on
+    std::vector<float> worldLatents; // world.size() * latentDim values, or empty to let the server look them up
+    unsigned int latentDim = 0;
+
+    std::vector<int> ids; // queueNum of each tile to generate
+    std::vector<glm::dvec2> coords; // (x, z) of each tile to generate, in order
+    bool returnLatents = false; // Ask for the latent vectors of the new tiles
+
+    // Ask for the images as imageSize square RGBA with imageLevels mip levels, instead of PNGs on disk.
+    // 0 keeps the old behavior: the server saves world_data/images/tile<id>.png before it answers.
+    unsigned int imageSize = 0;
+    unsigned int imageLevels = 1;
+    bool saveImages = false; // Have the server also write the PNGs, in the background
+};
+
+// Bytes in an RGBA8 mip chain of the given size and number of levels, at most GEN_MAX_IMAGE_SIZE and GEN_MAX_IMAGE_LEVELS
+inline size_t genChainBytes(unsigned int size, unsigned int levels) {
+    assert(size <= GEN_MAX_IMAGE_SIZE && levels <= GEN_MAX_IMAGE_LEVELS);
+    size_t bytes = 0;
+    for (unsigned int level = 0; level < levels; level++) {
+        size_t s = size >> level > 0 ? size >> level : 1;
+        bytes += 4 * s * s;
+    }
+    return bytes;
+}
+
+struct GenResult
+{
+    uint64_t id; // As returned by GenClient::submit()
+    bool ok;
+    std::string error; // Set if !ok
+
+    std::vector<int> ids; // Tiles that were generated
+    std::vector<float> latents; // ids.size() * latentDim values if returnLatents was set
+    unsigned int latentDim = 0;
+
+    // Staging buffer for the images, filled by the client thread: one mip chain per tile, back to back.
+    // Empty if the request had no imageSize or the server is too old to send images.
+    std::vector<unsigned char> pixels;
+    unsigned int imageSize = 0;
+    unsigned int imageLevels = 0;
+
+    const unsigned char* image(size_t i) const { return pixels.data() + i * genChainBytes(imageSize, imageLevels); }
+};
+
+std::string encodeGenRequest(const GenRequest& request);
+
+// Fill result from a response frame. Sets ok and error; returns ok.
+bool decodeGenResponse(const std::string& frame, GenResult& result);
+
+#endif
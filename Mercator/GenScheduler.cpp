@@ -0,0 +1,124 @@
+#include "GenScheduler.h"
+
+// Distance added for a megatile directly behind the camera; one in the view direction gets none
+const double VIEW_PENALTY = 1.0;
+
+// Distance added to prefetched megatiles, so visible ones at about the same distance go first
+const double PREFETCH_PENALTY = 1.0;
+
+// Prefetched megatiles farther than this from the camera are dropped
+const double PREFETCH_RANGE = 4.0;
+
+static double distanceFromCamera(Tile* t) {
+    return acosh(std::max(1.0, (Tile::isometry * t->center).y));
+}
+
+// dist() without the NaN when rounding puts minkDot just under 1
+static double distanceBetween(glm::dvec3 a, glm::dvec3 b) {
+    return acosh(std::max(1.0, minkDot(a, b)));
+}
+
+void GenScheduler::push(const std::vector<Tile*>& tiles, double time, bool prefetched) {
+    Megatile m = { tiles, time, 0, prefetched };
+    pending.push_back(m);
+}
+
+void GenScheduler::update(glm::dvec3 front) {
+    size_t kept = 0;
+    for (Megatile& m : pending) {
+        if (stale(m)) {
+            release(m);
+            dropped++;
+            continue;
+        }
+        pending[kept++] = m;
+    }
+    pending.resize(kept);
+
+    // The camera sits at the hyperboloid origin of the isometry's frame
+    glm::dvec2 view = glm::dvec2(front.x, front.z);
+    double viewLength = glm::length(view);
+    for (Megatile& m : pending) {
+        glm::dvec3 c = Tile::isometry * m.tiles[0]->center;
+        double distance = distanceFromCamera(m.tiles[0]);
+        double facing = 1;
+        glm::dvec2 toward = glm::dvec2(c.x, c.z);
+        double towardLength = glm::length(toward);
+        if (viewLength > 0 && towardLength > 1e-9)
+            facing = glm::dot(view, toward) / (viewLength * towardLength);
+        m.priority = distance + VIEW_PENALTY * (1 - facing) / 2 + (m.prefetched ? PREFETCH_PENALTY : 0);
+    }
+    std::sort(pending.begin(), pending.end(), [](const Megatile& a, const Megatile& b) { return a.priority > b.priority; });
+}
+
+Megatile GenScheduler::pop() {
+    Megatile m = pending.back();
+    pending.pop_back();
+    return m;
+}
+
+bool GenScheduler::stale(const Megatile& m) {
+    // Requests carry layout positions. After a relayout, tiles that haven't been laid out again still hold
+    // positions in the old frame, and a request mixing the two would place them wrongly on the server.
+    for (Tile* t : m.tiles) {
+        if (t->laidOut != Tile::layout)
+            return true;
+    }
+    if (m.prefetched && distanceFromCamera(m.tiles[0]) < PREFETCH_RANGE)
+        return false;
+    for (Tile* t : m.tiles) {
+        if (t->isVisible())
+            return false;
+    }
+    return true;
+}
+
+void GenScheduler::release(Megatile& m) {
+    Tile* p = m.tiles[0];
+    for (Tile* t : m.tiles) {
+        t->texture = -1;
+        t->queueNum = -1;
+        t->hasLatent = false;
+        if (t->parent == p)
+            t->parent = NULL;
+    }
+}
+
+std::vector<Tile*> GenScheduler::claim(Tile* p) {
+    std::vector<Tile*> tiles;
+    if (p->parent)
+        return tiles;
+
+    // Requests carry layout positions, so only take tiles laid out around the current origin
+    p->parent = p;
+    tiles.push_back(p);
+    for (Tile* t : p->getNeighbors()) {
+        if (!t->parent && t->laidOut == Tile::layout) {
+            t->parent = p;
+            tiles.push_back(t);
+        }
+    }
+    return tiles;
+}
+
+std::vector<Tile*> GenScheduler::path(Tile* start, glm::dvec3 target) {
+    std::vector<Tile*> tiles;
+    Tile* t = start;
+    double best = distanceBetween(Tile::isometry * t->center, target);
+    while (true) {
+        Tile* closer = NULL;
+        for (Tile* neighbor : t->getNeighbors()) {
+            if (neighbor->laidOut != Tile::layout)
+                continue;
+            double d = distanceBetween(Tile::isometry * neighbor->center, target);
+            if (d < best) {
+                best = d;
+                closer = neighbor;
+            }
+        }
+        if (!closer)
+            return tiles;
+        t = closer;
+        tiles.push_back(t);
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef GENSCHEDULER_H
+#define GENSCHEDULER_H
+
+#include "Tile.h"
+#include <vector>
+
+/* Orders the megatiles waiting for images by how soon the user will see them.
+* Each frame, update() ranks them by hyperbolic distance from the camera plus a penalty for lying away from
+* the view direction, and drops the ones that have left Tile::visible before being sent.
+* Megatiles can also be prefetched along the path the camera is moving on. Those rank behind visible ones at
+* the same distance, and are dropped once they fall far behind the camera instead of when they leave the view. */
+
+struct Megatile
+{
+    std::vector<Tile*> tiles; // tiles[0] is the parent
+    double queued; // Time it was formed, for time-to-image
+    double priority; // Lower is sooner
+    bool prefetched; // Formed ahead of the camera rather than where it stands
+};
+
+class GenScheduler
+{
+public:
+    std::vector<Megatile> pending; // Sorted by descending priority after update(), so the next one is last
+    size_t dropped; // Megatiles dropped so far
+
+    GenScheduler() : dropped(0) {}
+
+    void push(const std::vector<Tile*>& tiles, double time, bool prefetched = false);
+
+    // Re-rank for the current camera. front is the view direction, in the same space as Tile::isometry.
+    void update(glm::dvec3 front);
+
+    bool empty() const { return pending.empty(); }
+    size_t size() const { return pending.size(); }
+
+    // Take the best ranked megatile
+    Megatile pop();
+
+    // A megatile that can't or needn't be generated any more: one of its tiles is out of the current layout,
+    // or none of them are visible, or for a prefetched one, it has fallen out of range
+    static bool stale(const Megatile& m);
+
+    // Mark p as a megatile parent, along with its neighbors that don't have one yet. Returns the megatile,
+    // parent first, or nothing if p already belongs to one.
+    static std::vector<Tile*> claim(Tile* p);
+
+    // Tiles the camera passes over on its way from start to target (a point in the Tile::isometry frame),
+    // not including start. Follows laid-out tiles only, so it stops at the edge of the known graph.
+    static std::vector<Tile*> path(Tile* start, glm::dvec3 target);
+
+    // Undo the marks made when the megatile was formed, so its tiles can be picked up again when seen
+    static void release(Megatile& m);
+};
+
+#endif
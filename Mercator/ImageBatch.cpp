@@ -0,0 +1,184 @@
+#include "ImageBatch.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+
+// Unit quad facing +z; image.vs scales it, lifts it above the plane and turns it toward the origin
+static const float quad[] = {
+    // positions          // normals          // texture coords
+     1.0f,  1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  1.0f, 0.0f,
+    -1.0f,  1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  0.0f, 0.0f,
+    -1.0f, -1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  0.0f, 1.0f,
+
+     1.0f,  1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  1.0f, 0.0f,
+    -1.0f, -1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  0.0f, 1.0f,
+     1.0f, -1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  1.0f, 1.0f
+};
+
+// Resample an RGBA image to size x size, averaging the source pixels that fall under each destination pixel
+static void resample(const unsigned char* src, int width, int height, unsigned char* dst, int size) {
+    for (int y = 0; y < size; y++) {
+        int y0 = y * height / size;
+        int y1 = std::max(y0 + 1, (y + 1) * height / size);
+        for (int x = 0; x < size; x++) {
+            int x0 = x * width / size;
+            int x1 = std::max(x0 + 1, (x + 1) * width / size);
+            unsigned int sum[4] = { 0 };
+            for (int sy = y0; sy < y1; sy++) {
+                for (int sx = x0; sx < x1; sx++) {
+                    for (int c = 0; c < 4; c++)
+                        sum[c] += src[4 * (sy * width + sx) + c];
+                }
+            }
+            unsigned int count = (y1 - y0) * (x1 - x0);
+            for (int c = 0; c < 4; c++)
+                dst[4 * (y * size + x) + c] = sum[c] / count;
+        }
+    }
+}
+
+ImageBatch::ImageBatch(int layerSize, int layersPerArray) : layerSize(layerSize), layersPerArray(layersPerArray) {
+    GLint maxLayers;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+    this->layersPerArray = std::min(layersPerArray, (int)maxLayers);
+
+    levels = 1;
+    for (int size = layerSize; size > 1; size /= 2)
+        levels++;
+    numLayers = 0;
+    bytesUploaded = 0;
+    bytesAsDoubles = 0;
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &quadVBO);
+    glGenBuffers(1, &instanceVBO);
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+
+    // Per-instance attributes; pointers are set per texture array in draw()
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+    glEnableVertexAttribArray(4);
+    glVertexAttribDivisor(4, 1);
+    glBindVertexArray(0);
+}
+
+void ImageBatch::addArray() {
+    unsigned int array;
+    glGenTextures(1, &array);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+    for (int level = 0, size = layerSize; level < levels; level++, size = std::max(1, size / 2))
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, size, size, layersPerArray, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    arrays.push_back(array);
+    buckets.resize(arrays.size());
+}
+
+int ImageBatch::load(const char* path) {
+    int width, height, nrComponents;
+    unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 4);
+    if (!data) {
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+        return -1;
+    }
+    int layer = add(data, width, height);
+    stbi_image_free(data);
+    return layer;
+}
+
+int ImageBatch::add(const unsigned char* rgba, int width, int height, int givenLevels) {
+    int layer = numLayers++;
+    if (layer / layersPerArray >= (int)arrays.size())
+        addArray();
+
+    // Fill the whole mip chain of the layer here, since glGenerateMipmap would redo every layer of the array
+    std::vector<unsigned char> pixels;
+    const unsigned char* level0 = rgba;
+    if (width != layerSize || height != layerSize) {
+        pixels.resize(4 * layerSize * layerSize);
+        resample(rgba, width, height, pixels.data(), layerSize);
+        level0 = pixels.data();
+        givenLevels = 1;
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, arrays.at(layer / layersPerArray));
+    const unsigned char* current = level0;
+    int size = layerSize;
+    for (int level = 0; level < levels; level++) {
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer % layersPerArray, size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE, current);
+        if (size > 1) {
+            if (level + 1 < givenLevels) {
+                current += 4 * size * size;
+            } else {
+                std::vector<unsigned char> smaller(4 * (size / 2) * (size / 2));
+                resample(current, size, size, smaller.data(), size / 2);
+                pixels.swap(smaller);
+                current = pixels.data();
+            }
+            size /= 2;
+        }
+    }
+    return layer;
+}
+
+void ImageBatch::update(const std::vector<Tile*>& tiles) {
+    for (auto& bucket : buckets)
+        bucket.clear();
+
+    for (Tile* t : tiles) {
+        if (t->texture != -1) {
+            Instance instance = { glm::vec3(t->center), t->texture % layersPerArray };
+            buckets.at(t->texture / layersPerArray).push_back(instance);
+        }
+    }
+
+    instances.clear();
+    for (auto& bucket : buckets)
+        instances.insert(instances.end(), bucket.begin(), bucket.end());
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(Instance), instances.data(), GL_STREAM_DRAW);
+
+    bytesUploaded += instances.size() * sizeof(Instance);
+    bytesAsDoubles += instances.size() * (sizeof(glm::dvec3) + sizeof(double));
+}
+
+void ImageBatch::draw(unsigned int textureUnit) {
+    glActiveTexture(GL_TEXTURE0 + textureUnit);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+
+    size_t start = 0;
+    for (size_t i = 0; i < arrays.size(); i++) {
+        size_t count = buckets.at(i).size();
+        if (count == 0)
+            continue;
+
+        // No base instance in GL 3.3, so point the instance attributes at this array's range instead
+        size_t offset = start * sizeof(Instance);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(offset + offsetof(Instance, center)));
+        glVertexAttribIPointer(4, 1, GL_INT, sizeof(Instance), (void*)(offset + offsetof(Instance, layer)));
+
+        glBindTexture(GL_TEXTURE_2D_ARRAY, arrays.at(i));
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6, (GLsizei)count);
+        start += count;
+    }
+    glBindVertexArray(0);
+}
@@ -0,0 +1,64 @@
+#ifndef IMAGEBATCH_H
+#define IMAGEBATCH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "Tile.h"
+
+#include <vector>
+
+/* Draws the images of all visible tiles as instanced billboards.
+* Images are resampled to a fixed size and stored as layers of GL_TEXTURE_2D_ARRAY textures,
+* so each array needs only one texture bind and one glDrawArraysInstanced call.
+* Per instance, image.vs receives the tile center and the layer; it does the projection and the
+* face-the-origin rotation itself. */
+
+class ImageBatch
+{
+public:
+    unsigned int VAO;
+    unsigned int quadVBO;
+    unsigned int instanceVBO;
+    std::vector<unsigned int> arrays; // GL_TEXTURE_2D_ARRAY textures, each holding layersPerArray images
+
+    size_t bytesUploaded; // Running total of instance bytes sent to the GPU
+    size_t bytesAsDoubles; // What the same uploads would have cost with GL_DOUBLE centers
+
+    ImageBatch(int layerSize = 256, int layersPerArray = 128);
+
+    // Load an image file into a free layer. Returns the layer, or -1 if the file could not be read.
+    int load(const char* path);
+
+    // Copy 8-bit RGBA pixels into a free layer, resampling them to layerSize. Returns the layer.
+    // rgba may hold the first givenLevels levels of a mip chain back to back, each half the size of the one
+    // before; if the image is already layerSize square they are uploaded as is instead of being recomputed.
+    int add(const unsigned char* rgba, int width, int height, int givenLevels = 1);
+
+    int size() const { return layerSize; }
+    int mipLevels() const { return levels; }
+
+    // Collect an instance for every tile that has an image
+    void update(const std::vector<Tile*>& tiles);
+
+    // Draw the instances from the last update(). Expects image.vs/image.fs to be in use.
+    void draw(unsigned int textureUnit = 0);
+
+private:
+    struct Instance
+    {
+        glm::vec3 center; // Tile center on the hyperboloid, relative to the origin tile
+        GLint layer; // Layer within its texture array
+    };
+
+    int layerSize;
+    int layersPerArray;
+    int levels; // Mipmap levels per layer
+    int numLayers; // Layers handed out so far
+
+    std::vector<std::vector<Instance>> buckets; // Instances grouped by texture array
+    std::vector<Instance> instances;
+
+    void addArray();
+};
+
+#endif
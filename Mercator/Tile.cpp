@@ -1,230 +1,375 @@
 #include "Tile.h"
+#include "hyperBatch.h"
 
 // For origin tile
-Tile::Tile(int n, int k) : name("O"), n(n), k(k) {
+Tile::Tile(TileId id, int n, int k) : id(id), name("O"), n(n), k(k) {
     float r = ((float)rand() / (RAND_MAX));
     float g = ((float)rand() / (RAND_MAX));
     float b = ((float)rand() / (RAND_MAX));
     color = glm::vec4(r, g, b, 1.0f);
 
     center = glm::dvec3(0, 1, 0);
+    vertices.fill(NO_ID);
+    edges.fill(NO_ID);
 
-    //Vertex* first_vert = new Vertex(k, hypNormalize(reversePoincare(circleRadius(n, k), 0)));
-    Vertex* first_vert = new Vertex(k, reversePoincare(circleRadius(n, k), 0));
-    vertices.push_back(first_vert);
-    Edge* first_edge = first_vert->edges.at(0);
+    //VertexId first_vert = Graph::addVertex(k, hypNormalize(reversePoincare(circleRadius(n, k), 0)));
+    VertexId first_vert = Graph::addVertex(k, reversePoincare(circleRadius(n, k), 0));
+    vertices[0] = first_vert;
+    EdgeId first_edge = Graph::vertices[first_vert].edges[0];
     
-    Edge* edge = first_edge;
-    edge->addTile(this);
+    EdgeId edge = first_edge;
+    Graph::addTile(edge, id);
 
     for (int i = 1; i < n; i++) {
-        Vertex* next_vert = edge->vertex2;
-        glm::dvec3 next_loc = rotate(vertices.at(i - 1)->getPos(), 2 * M_PI / n);
-        next_vert->clamp(next_loc);
-        vertices.push_back(next_vert);
+        VertexId next_vert = Graph::edges[edge].vertex2;
+        glm::dvec3 next_loc = rotate(Graph::getPos(vertices[i - 1]), 2 * M_PI / n);
+        Graph::clamp(next_vert, next_loc);
+        vertices[i] = next_vert;
         
-        edge = next_vert->prev(edge);
-        edge->addTile(this);
+        edge = Graph::prev(next_vert, edge);
+        Graph::addTile(edge, id);
     }
     
-    Edge* merge_edge = first_vert->next(first_edge);
-    edge->merge(merge_edge);
+    EdgeId merge_edge = Graph::next(first_vert, first_edge);
+    Graph::merge(edge, merge_edge);
 
     populateEdges();
 
     texture = -1;
     angle = 0;
     queueNum = -1;
+    hasLatent = false;
+    parent = NULL;
+
+    visibleStamp = 0;
+    visibleIndex = -1;
+    expanded = false;
+    support = 0;
+    inRing = false;
+    laidOut = 0;
+
+    slot = -1;
+    uploaded = 0;
 }
 
 // For non-origin tiles
-Tile::Tile(Tile* ref, Edge* e, int n, int k) : name("N"), n(n), k(k) {
+Tile::Tile(TileId id, Tile* ref, EdgeId e, int n, int k) : id(id), name("N"), n(n), k(k) {
     float r = ((float)rand() / (RAND_MAX));
     float g = ((float)rand() / (RAND_MAX));
     float b = ((float)rand() / (RAND_MAX));
     color = glm::vec4(r, g, b, 1.0f);
 
-    e->addTile(this);
+    vertices.fill(NO_ID);
+    edges.fill(NO_ID);
 
-    center = extend(ref->center, midpoint(e->vertex1->getPos(), e->vertex2->getPos()));
+    Graph::addTile(e, id);
 
-    std::vector<Vertex*> verts = e->verts(center);
-    vertices.push_back(verts.at(1));
+    center = extend(ref->center, midpoint(Graph::getPos(Graph::edges[e].vertex1), Graph::getPos(Graph::edges[e].vertex2)));
 
-    Vertex* back_vert = verts.at(0);
-    Vertex* front_vert = verts.at(1);
+    std::array<VertexId, 2> verts = Graph::verts(e, center);
+    VertexId back_vert = verts[0];
+    VertexId front_vert = verts[1];
 
-    vertices.insert(vertices.begin(), back_vert);
+    // Vertices are found both backward and forward from e, so collect them from the middle of a buffer outward
+    VertexId found[2 * MAX_N + 2];
+    int first = MAX_N + 1;
+    int last = first;
+    found[last++] = front_vert;
+    found[--first] = back_vert;
 
-    Edge* back_edge = back_vert->next(e);
-    while (back_vert != front_vert && !back_edge->hasDangling()) {
-        back_edge->addTile(this);
-        back_vert = (back_vert == back_edge->vertex1) ? back_edge->vertex2 : back_edge->vertex1; //back_vert = back_edge->verts(center).at(0);
-        vertices.insert(vertices.begin(), back_vert);
-        back_edge = back_vert->next(back_edge);
+    EdgeId back_edge = Graph::next(back_vert, e);
+    while (back_vert != front_vert && !Graph::hasDangling(back_edge)) {
+        Graph::addTile(back_edge, id);
+        back_vert = Graph::other(back_edge, back_vert); //back_vert = Graph::verts(back_edge, center)[0];
+        found[--first] = back_vert;
+        back_edge = Graph::next(back_vert, back_edge);
     }
 
     // Made a loop; all vertices accounted for
     if (back_vert == front_vert)
-        vertices.erase(vertices.begin());
+        first++;
     else { // Need to complete the vertices
         
-        Vertex* vertex = front_vert;
-        Edge* edge = vertex->prev(e);
-        edge->addTile(this);
+        VertexId vertex = front_vert;
+        EdgeId edge = Graph::prev(vertex, e);
+        Graph::addTile(edge, id);
 
-        Vertex* reflecting_vertex = e->verts(ref->center).at(1);
-        Edge* ref_edge = reflecting_vertex->prev(e);
+        VertexId reflecting_vertex = Graph::verts(e, ref->center)[1];
+        EdgeId ref_edge = Graph::prev(reflecting_vertex, e);
 
-        glm::dvec3 midpt = midpoint(e->vertex1->getPos(), e->vertex2->getPos());
+        glm::dvec3 midpt = midpoint(Graph::getPos(Graph::edges[e].vertex1), Graph::getPos(Graph::edges[e].vertex2));
 
-        int size = vertices.size();
+        int size = last - first;
         for (int i = size; i < n; i++) {
-            reflecting_vertex = (reflecting_vertex == ref_edge->vertex1) ? ref_edge->vertex2 : ref_edge->vertex1; //reflecting_vertex = ref_edge->verts(ref->center).at(1);
+            reflecting_vertex = Graph::other(ref_edge, reflecting_vertex); //reflecting_vertex = Graph::verts(ref_edge, ref->center)[1];
 
-            glm::dvec3 next_loc = extend(reflecting_vertex->getPos(), midpt);
-            if (!edge->vertex2->initialized) {
-                vertex = edge->vertex2;
-                vertex->clamp(next_loc);
+            glm::dvec3 next_loc = extend(Graph::getPos(reflecting_vertex), midpt);
+            if (!Graph::vertices[Graph::edges[edge].vertex2].initialized) {
+                vertex = Graph::edges[edge].vertex2;
+                Graph::clamp(vertex, next_loc);
             } else {
-                vertex = (vertex == edge->vertex1) ? edge->vertex2 : edge->vertex1; // vertex = edge->verts(center).at(1);
-                vertex->setPos(next_loc);
+                vertex = Graph::other(edge, vertex); // vertex = Graph::verts(edge, center)[1];
+                Graph::setPos(vertex, next_loc);
             }
 
-            vertices.push_back(vertex);
+            found[last++] = vertex;
 
-            edge = vertex->prev(edge);
-            ref_edge = reflecting_vertex->prev(ref_edge);
-            edge->addTile(this);
+            edge = Graph::prev(vertex, edge);
+            ref_edge = Graph::prev(reflecting_vertex, ref_edge);
+            Graph::addTile(edge, id);
         }
 
-        edge->merge(back_edge);
+        Graph::merge(edge, back_edge);
     }
 
+    assert(last - first == n);
+    std::copy(found + first, found + last, vertices.begin());
+
     populateEdges();
 
     texture = -1;
     angle = 0;
     queueNum = -1;
+    hasLatent = false;
+    parent = NULL;
+
+    visibleStamp = 0;
+    visibleIndex = -1;
+    expanded = false;
+    support = 0;
+    inRing = false;
+    laidOut = 0;
+
+    slot = -1;
+    uploaded = 0;
+}
+
+Tile* Tile::create(int n, int k) {
+    arena.emplace_back((TileId)arena.size(), n, k);
+    return &arena.back();
+}
+
+Tile* Tile::create(Tile* ref, EdgeId e, int n, int k) {
+    arena.emplace_back((TileId)arena.size(), ref, e, n, k);
+    return &arena.back();
 }
 
 void Tile::populateEdges() {
     for (int i = 0; i < n; i++) {
-        Vertex* v1 = vertices.at(i);
-        Vertex* v2 = vertices.at((i + 1) % n);
-        edges.push_back(v1->seekVertex(v2));
+        VertexId v1 = vertices[i];
+        VertexId v2 = vertices[(i + 1) % n];
+        edges[i] = Graph::seekVertex(v1, v2);
     }
-
-    /*Vertex* v1 = vertices.at(0);
-    Vertex* v2 = vertices.at(1);
-    Edge* sweep = v1->seekVertex(v2);
-    edges.push_back(sweep);
-    Vertex* front = sweep->verts(center).at(1);
-
-    for (int i = 0; i < n - 1; i++) {
-        sweep = front->prev(sweep);
-        edges.push_back(sweep);
-        front = sweep->verts(center).at(1);
-    }*/
 }
 
-int Tile::findEdge(Edge* e) {
-    auto it = std::find(edges.begin(), edges.end(), e);
-    assert(it != edges.end());
+int Tile::findEdge(EdgeId e) {
+    auto it = std::find(edges.begin(), edges.begin() + n, e);
+    assert(it != edges.begin() + n);
     return it - edges.begin();
 }
 
-void Tile::setVertexLocs(Tile* ref, Edge* e) {
-    glm::dvec3 midpt = midpoint(e->vertex1->getPos(), e->vertex2->getPos());
+void Tile::setVertexLocs(Tile* ref, EdgeId e) {
+    laidOut = layout;
+    glm::dvec3 midpt = midpoint(Graph::getPos(Graph::edges[e].vertex1), Graph::getPos(Graph::edges[e].vertex2));
     center = extend(ref->center, midpt);
 
-    Vertex* vertex = e->verts(center).at(1);
-    Edge* edge = vertex->prev(e);
+    VertexId vertex = Graph::verts(e, center)[1];
+    EdgeId edge = Graph::prev(vertex, e);
 
-    Vertex* reflecting_vertex = e->verts(ref->center).at(1);
-    Edge* ref_edge = reflecting_vertex->prev(e);
+    VertexId reflecting_vertex = Graph::verts(e, ref->center)[1];
+    EdgeId ref_edge = Graph::prev(reflecting_vertex, e);
 
     for (int i = 0; i < n-2; i++) {
         // ccw vertex ordering breaks down when the vertex locations are inaccurate.
         // Need to rely on comparing vertex1 and vertex2 instead of using verts().
-        vertex = (vertex == edge->vertex1) ? edge->vertex2 : edge->vertex1;
-        reflecting_vertex = (reflecting_vertex == ref_edge->vertex1) ? ref_edge->vertex2 : ref_edge->vertex1; //reflecting_vertex = ref_edge->verts(ref->center).at(1);
+        vertex = Graph::other(edge, vertex);
+        reflecting_vertex = Graph::other(ref_edge, reflecting_vertex); //reflecting_vertex = Graph::verts(ref_edge, ref->center)[1];
         
-        glm::dvec3 next_loc = extend(reflecting_vertex->getPos(), midpt);
-        vertex->setPos(next_loc);
+        glm::dvec3 next_loc = extend(Graph::getPos(reflecting_vertex), midpt);
+        Graph::setPos(vertex, next_loc);
 
-        edge = vertex->prev(edge);
-        ref_edge = reflecting_vertex->prev(ref_edge);
+        edge = Graph::prev(vertex, edge);
+        ref_edge = Graph::prev(reflecting_vertex, ref_edge);
     }
 }
 
-void Tile::setVertexLocs2(Tile* ref, Edge* e) {
-    glm::dvec3 midpt = midpoint(e->vertex1->getPos(), e->vertex2->getPos());
+void Tile::setVertexLocs2(Tile* ref, EdgeId e) {
+    laidOut = layout;
+    glm::dvec3 midpt = midpoint(Graph::getPos(Graph::edges[e].vertex1), Graph::getPos(Graph::edges[e].vertex2));
     center = extend(ref->center, midpt);
 
-    Vertex* vertex = e->verts(center).at(1);
-    Edge* edge = vertex->prev(e);
+    VertexId vertex = Graph::verts(e, center)[1];
+    EdgeId edge = Graph::prev(vertex, e);
 
-    Vertex* reflecting_vertex = vertex;
-    Edge* ref_edge = reflecting_vertex->next(e);
+    VertexId reflecting_vertex = vertex;
+    EdgeId ref_edge = Graph::next(reflecting_vertex, e);
 
     for (int i = 0; i < n - 2; i++) {
         // ccw vertex ordering breaks down when the vertex locations are inaccurate.
         // Need to rely on comparing vertex1 and vertex2 instead of using verts().
-        vertex = (vertex == edge->vertex1) ? edge->vertex2 : edge->vertex1;
-        reflecting_vertex = (reflecting_vertex == ref_edge->vertex1) ? ref_edge->vertex2 : ref_edge->vertex1;
+        vertex = Graph::other(edge, vertex);
+        reflecting_vertex = Graph::other(ref_edge, reflecting_vertex);
 
-        glm::dvec3 next_loc = symmetry(reflecting_vertex->getPos(), ref->center, center);
-        vertex->setPos(next_loc);
+        glm::dvec3 next_loc = symmetry(Graph::getPos(reflecting_vertex), ref->center, center);
+        Graph::setPos(vertex, next_loc);
 
-        edge = vertex->prev(edge);
-        ref_edge = reflecting_vertex->next(ref_edge);
+        edge = Graph::prev(vertex, edge);
+        ref_edge = Graph::next(reflecting_vertex, ref_edge);
     }
 }
 
 void Tile::expand() {
-    for (Edge* e : edges) {
+    expanded = true;
+    for (int i = 0; i < n; i++) {
+        EdgeId e = edges[i];
         Tile* other_tile = NULL;
-        if (e->tiles.size() < 2) {
-            other_tile = new Tile(this, e, n, k);
-            all.push_back(other_tile);
+        if (Graph::edges[e].numTiles < 2) {
+            other_tile = create(this, e, n, k);
         }
         else {
-            assert(e->tiles.size() == 2);
-            other_tile = (this == e->tiles.at(0)) ? e->tiles.at(1) : e->tiles.at(0);
+            const Edge& edge = Graph::edges[e];
+            other_tile = get((id == edge.tiles[0]) ? edge.tiles[1] : edge.tiles[0]);
             // other_tile->setVertexLocs(this, e);
         }
-        if (other_tile && !other_tile->isVisible()) {
+        if (!other_tile->isVisible()) {
+            other_tile->show();
+            // Positions set earlier in this layout are still valid
+            if (other_tile->laidOut != layout)
+                other_tile->setVertexLocs2(this, e);
             next.push_back(other_tile);
-            visible.push_back(other_tile);
-            other_tile->setVertexLocs2(this, e);
         }
+        other_tile->support++;
+        other_tile->markRing();
     }
 }
 
-void Tile::setStart(glm::dvec3 relPos) {
-    //vertices.at(0)->setPos(rotate(hypNormalize(reversePoincare(circleRadius(n, k), 0)), angle));
-    vertices.at(0)->setPos(rotate(reversePoincare(circleRadius(n, k), 0), angle));
-    for (int i = 1; i < n; i++)
-        vertices.at(i)->setPos(rotate(vertices.at(i - 1)->getPos(), 2 * M_PI / n));
+void Tile::collapse() {
+    expanded = false;
+    for (Tile* t : getNeighbors()) {
+        t->support--;
+        t->markRing();
+    }
+}
+
+void Tile::show() {
+    visibleStamp = epoch;
+    visibleIndex = visible.size();
+    visible.push_back(this);
+    expanded = false;
+    support = 0;
+}
 
-    for (int i = 0; i < n; i++)
-        vertices.at(i)->setPos(translateXZ(vertices.at(i)->getPos(), relPos.x, relPos.z));
+void Tile::hide() {
+    Tile* last = visible.back();
+    visible.at(visibleIndex) = last;
+    last->visibleIndex = visibleIndex;
+    visible.pop_back();
+    visibleStamp = 0;
+    visibleIndex = -1;
+}
 
-    center = translateXZ(glm::dvec3(0, 1, 0), relPos.x, relPos.z);
+void Tile::markRing() {
+    if (!inRing) {
+        inRing = true;
+        ring.push_back(this);
+    }
+}
 
-    next.clear();
-    next.push_back(this);
+void Tile::relayout() {
+    layout++;
+    frame = Isometry();
+
+    // Place the first vertex, then step around the center with one rotation
+    //Graph::setPos(vertices[0], rotate(hypNormalize(reversePoincare(circleRadius(n, k), 0)), angle));
+    glm::dvec3 pos = Isometry::rotate(angle) * reversePoincare(circleRadius(n, k), 0);
+    Isometry step = Isometry::rotate(2 * M_PI / n);
+    for (int i = 0; i < n; i++) {
+        Graph::setPos(vertices[i], pos);
+        pos = step * pos;
+    }
+    center = glm::dvec3(0, 1, 0);
+    laidOut = layout;
 
+    epoch++;
+    for (Tile* t : ring)
+        t->inRing = false;
+    ring.clear();
     visible.clear();
-    visible.push_back(this);
 
-    while (next.size() != 0) {
-        Tile* t = next.back();
-        next.pop_back();
-        if (t->withinRadius(0.75))
-            t->expand();
+    show();
+    markRing();
+}
+
+// Hyperbolic distance from the layout origin beyond which a new origin is laid out again,
+// so that tile positions stay small enough to upload as floats
+const double REBASE_DISTANCE = 3.0;
+
+void Tile::setStart(glm::dvec3 relPos) {
+    bool rebuild = (origin == NULL);
+    if (this != origin) {
+        if (origin)
+            origin->markRing();
+        origin = this;
+
+        // Fold the change of origin into frame, so that the camera sees the same thing as last frame
+        frame = Isometry::translateXZ(relPos.x, relPos.z).inverse() * isometry;
+        if (!isVisible() || laidOut != layout || center.y > cosh(REBASE_DISTANCE))
+            rebuild = true;
+    }
+    if (rebuild)
+        relayout();
+    isometry = Isometry::translateXZ(relPos.x, relPos.z) * frame;
+
+    // Re-test the ring. Tiles made visible by expand() are tested in the same pass, level by level,
+    // so the radius test can run over all vertices of a level at once.
+    static std::vector<Tile*> level;
+    static HypPoints points;
+    static std::vector<unsigned char> inside;
+    level.clear();
+    for (Tile* t : ring) {
+        t->inRing = false;
+        if (t->isVisible())
+            level.push_back(t);
+    }
+    ring.clear();
+
+    while (level.size() != 0) {
+        points.clear();
+        for (Tile* t : level) {
+            for (int j = 0; j < n; j++)
+                points.push_back(Graph::positions[t->vertices[j]]);
+        }
+        inside.resize(points.size());
+        batchWithinRadius(isometry, points, 0.75, inside.data());
+        tested += level.size();
+
+        // expand() fills next with the tiles it makes visible
+        next.clear();
+        for (size_t i = 0; i < level.size(); i++) {
+            Tile* t = level[i];
+            unsigned char* flags = &inside[i * n];
+            bool within = std::find(flags, flags + n, 1) != flags + n;
+            if (within && !t->expanded)
+                t->expand();
+            else if (!within && t->expanded)
+                t->collapse();
+            t->markRing();
+        }
+        level.swap(next);
+    }
+
+    // Drop tiles that lost all support, and let go of tiles that are now surrounded by expanded tiles
+    size_t kept = 0;
+    for (Tile* t : ring) {
+        if (t->isVisible() && !t->expanded && t->support == 0 && t != origin)
+            t->hide();
+        if (!t->isVisible() || (t->expanded && t->support == t->n)) {
+            t->inRing = false;
+            continue;
+        }
+        ring[kept++] = t;
     }
+    ring.resize(kept);
 
     /*
     // This is for marking tiles to receive generated outputs; comment out to disable
@@ -240,24 +385,19 @@ void Tile::setStart(glm::dvec3 relPos) {
 
 std::vector<Tile*> Tile::getNeighbors() {
     std::vector<Tile*> neighbors;
-    for (Edge* e : edges) {
-        if (e->tiles.size() == 2) {
-            Tile* neighbor = (this == e->tiles.at(0)) ? e->tiles.at(1) : e->tiles.at(0);
+    for (int i = 0; i < n; i++) {
+        const Edge& e = Graph::edges[edges[i]];
+        if (e.numTiles == 2) {
+            Tile* neighbor = get((id == e.tiles[0]) ? e.tiles[1] : e.tiles[0]);
             neighbors.push_back(neighbor);
         }
     }
     return neighbors;
 }
 
-bool Tile::isVisible() {
-    if (std::find(visible.begin(), visible.end(), this) != visible.end())
-        return true;
-    return false;
-}
-
 bool Tile::withinRadius(double rad) {
-    for (Vertex* v : vertices) {
-        if (glm::distance(glm::dvec3(0), getPoincare(v->getPos())) < rad)
+    for (int i = 0; i < n; i++) {
+        if (glm::distance(glm::dvec3(0), getPoincare(isometry * Graph::getPos(vertices[i]))) < rad)
             return true;
     }
     return false;
@@ -7,6 +7,7 @@
 #include <random>
 #include <vector>
 #include <queue>
+#include <deque>
 #include <algorithm>
 #include <iostream>
 
@@ -17,46 +18,89 @@
 class Tile
 {
 public:
+    static std::deque<Tile> arena; // All tiles, indexed by id. A deque, so Tile pointers stay valid as it grows.
     static std::vector<Tile*> visible;
     static std::vector<Tile*> next;
-    static std::vector<Tile*> all;
     static std::queue<Tile*> parents;
 
+    // Tile positions are kept relative to the tile that setStart() was last called on.
+    // The camera offset is applied separately through this isometry (in the vertex shader when drawing).
+    static Isometry isometry;
+    static Tile* origin;
+    static unsigned int layout; // Incremented whenever the tiles are laid out around a new origin
+
+    // Tiles are only laid out again when origin moves far from the tile they were laid out around.
+    // Until then, frame maps layout positions into origin's frame, and isometry = translation * frame.
+    static Isometry frame;
+
+    // The visible set is kept from frame to frame. Only the tiles on its edge are re-tested.
+    static unsigned int epoch; // Tiles with visibleStamp == epoch are visible; incremented to clear the set
+    static std::vector<Tile*> ring; // Visible tiles that are not expanded, or have a neighbor that isn't
+    static size_t tested; // Running total of tiles radius-tested by setStart()
+
+    TileId id; // Index in arena
     glm::dvec3 center;
     std::string name;
     glm::vec4 color;
-    int texture;
+    int texture; // Layer in the ImageBatch texture arrays, -1 if none
     double angle;
-    int queueNum;
+    int queueNum; // Index the tile's image is generated under, -1 until it is requested
+    bool hasLatent; // The server has stored a latent vector under queueNum; set when the generation completes
     Tile* parent;
 
-    std::vector<Vertex*> vertices; // CCW order
-    std::vector<Edge*> edges; // CCW order
+    unsigned int visibleStamp; // Equal to epoch while visible
+    int visibleIndex; // Position in visible
+    bool expanded; // Within the radius, with all its neighbors made visible
+    int support; // Number of expanded neighbors. Visible tiles other than origin are dropped when this reaches 0.
+    bool inRing;
+    unsigned int laidOut; // Value of layout when the vertex positions were last set
+
+    int slot; // Slot in the TileBatch vertex buffer holding this tile's positions, -1 if none
+    unsigned int uploaded; // Value of layout when the positions were last uploaded
+
+    std::array<VertexId, MAX_N> vertices; // CCW order, first n are set
+    std::array<EdgeId, MAX_N> edges; // CCW order, first n are set
 
     int n; // Number of vertices per tile
     int k; // Number of tiles per vertex
 
-    Tile(int n, int k);
-    Tile(Tile* ref, Edge* e, int n, int k);
+    Tile(TileId id, int n, int k);
+    Tile(TileId id, Tile* ref, EdgeId e, int n, int k);
+
+    // Construct a tile in the arena
+    static Tile* create(int n, int k);
+    static Tile* create(Tile* ref, EdgeId e, int n, int k);
+    static Tile* get(TileId id) { return &arena[id]; }
 
-    void populateEdges(); // Once all vertices are set, fill edges vector with edges
-    int findEdge(Edge* e); // Find index of edge in edges vector
-    void setVertexLocs(Tile* ref, Edge* e); // Set vertex locations for this tile, given a reference tile and edge
-    void setVertexLocs2(Tile* ref, Edge* e);
+    void populateEdges(); // Once all vertices are set, fill edges array with edges
+    int findEdge(EdgeId e); // Find index of edge in edges array
+    void setVertexLocs(Tile* ref, EdgeId e); // Set vertex locations for this tile, given a reference tile and edge
+    void setVertexLocs2(Tile* ref, EdgeId e);
     std::vector<Tile*> getNeighbors(); // Get tile neighbors
 
-    // Expand in all four directions, creating new tiles if necessary
+    // Expand in all four directions, creating new tiles if necessary, and make the neighbors visible
     void expand();
 
-    // Set starting tile position based on relative position to its center
-    // Calls expand() repeatedly, breadth-first
+    // Undo expand(); neighbors left without support are dropped at the end of setStart()
+    void collapse();
+
+    // Set starting tile position based on relative position to its center.
+    // Re-tests the ring with batchWithinRadius(), expanding and collapsing tiles until the edge of the
+    // visible region settles. Lays out all tiles again only on the first call or when this tile is far
+    // from the current layout origin.
     void setStart(glm::dvec3 relPos);
 
-    // Check if tile is in vector of all currently updated/visible tiles
-    bool isVisible();
+    // Check if tile is in the set of currently visible tiles
+    bool isVisible() { return visibleStamp == epoch; }
 
-    // Check if any of tile's Poincare-projected vertices are within the given radius
+    // Check if any of tile's Poincare-projected vertices (as seen from the camera) are within the given radius
     bool withinRadius(double rad);
+
+private:
+    void relayout(); // Lay this tile out at the origin and restart the visible set from it
+    void show(); // Add to visible
+    void hide(); // Remove from visible
+    void markRing(); // Add to ring, if not already in it
 };
 
 #endif
\ No newline at end of file
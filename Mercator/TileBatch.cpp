@@ -0,0 +1,115 @@
+#include "TileBatch.h"
+
+TileBatch::TileBatch(int n, int capacity) : n(n), capacity(capacity) {
+    frame = 0;
+    bytesUploaded = 0;
+    bytesAsDoubles = 0;
+    staging.resize(3 * n);
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &colorBuffer);
+    glGenTextures(1, &colorTexture);
+    allocate();
+}
+
+void TileBatch::allocate() {
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, capacity * n * 3 * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glBindVertexArray(0);
+
+    glBindBuffer(GL_TEXTURE_BUFFER, colorBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, capacity * sizeof(glm::u8vec4), NULL, GL_DYNAMIC_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, colorTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA8, colorBuffer);
+
+    // Slot contents were lost; occupied slots need to be rewritten
+    for (Tile* t : owners) {
+        if (t)
+            t->uploaded = 0;
+    }
+
+    int old = owners.size();
+    owners.resize(capacity, NULL);
+    used.resize(capacity, 0);
+    for (int i = capacity - 1; i >= old; i--)
+        freeSlots.push_back(i);
+}
+
+void TileBatch::update(const std::vector<Tile*>& tiles) {
+    frame++;
+
+    // Release slots of tiles that are no longer visible
+    int unplaced = 0;
+    for (Tile* t : tiles) {
+        if (t->slot == -1)
+            unplaced++;
+        else
+            used.at(t->slot) = frame;
+    }
+    for (int i = 0; i < capacity; i++) {
+        if (owners.at(i) && used.at(i) != frame) {
+            owners.at(i)->slot = -1;
+            owners.at(i) = NULL;
+            freeSlots.push_back(i);
+        }
+    }
+
+    // Grow the buffers if the newly visible tiles do not fit
+    if (unplaced > (int)freeSlots.size()) {
+        int needed = capacity - freeSlots.size() + unplaced;
+        while (capacity < needed)
+            capacity *= 2;
+        allocate();
+    }
+
+    firsts.clear();
+    counts.clear();
+    for (Tile* t : tiles) {
+        if (t->slot == -1) {
+            t->slot = freeSlots.back();
+            freeSlots.pop_back();
+            owners.at(t->slot) = t;
+            used.at(t->slot) = frame;
+            t->uploaded = 0;
+        }
+        if (t->uploaded != Tile::layout)
+            write(t);
+
+        firsts.push_back(t->slot * n);
+        counts.push_back(n);
+    }
+}
+
+void TileBatch::write(Tile* t) {
+    for (int i = 0; i < n; i++) {
+        glm::dvec3 pos = Graph::getPos(t->vertices[i]);
+        staging.at(3 * i) = (float)pos.x;
+        staging.at(3 * i + 1) = (float)pos.y;
+        staging.at(3 * i + 2) = (float)pos.z;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferSubData(GL_ARRAY_BUFFER, t->slot * n * 3 * sizeof(float), n * 3 * sizeof(float), staging.data());
+
+    glm::u8vec4 color = glm::u8vec4(glm::clamp(t->color, 0.0f, 1.0f) * 255.0f + 0.5f);
+    glBindBuffer(GL_TEXTURE_BUFFER, colorBuffer);
+    glBufferSubData(GL_TEXTURE_BUFFER, t->slot * sizeof(glm::u8vec4), sizeof(glm::u8vec4), &color[0]);
+
+    bytesUploaded += n * 3 * sizeof(float) + sizeof(glm::u8vec4);
+    bytesAsDoubles += n * 3 * sizeof(double) + sizeof(glm::vec4);
+
+    t->uploaded = Tile::layout;
+}
+
+void TileBatch::draw(unsigned int textureUnit) {
+    if (firsts.empty())
+        return;
+    glActiveTexture(GL_TEXTURE0 + textureUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, colorTexture);
+    glBindVertexArray(VAO);
+    glMultiDrawArrays(GL_TRIANGLE_FAN, firsts.data(), counts.data(), (GLsizei)firsts.size());
+    glActiveTexture(GL_TEXTURE0);
+}
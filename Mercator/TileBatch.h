@@ -0,0 +1,57 @@
+#ifndef TILEBATCH_H
+#define TILEBATCH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "Tile.h"
+
+#include <vector>
+
+/* Batches the vertex fans of all visible tiles into one VBO so they can be drawn with a single call.
+* The VBO is split into fixed-size slots of n vertices. A tile keeps its slot while it stays visible,
+* and the slot is only rewritten when the tile's positions change. Tile colors live in a texture buffer
+* with one texel per slot, which shader.vs reads using gl_VertexID.
+*
+* Positions are computed in double relative to the layout origin. Tile::setStart lays the tiles out again
+* once the camera's tile is more than REBASE_DISTANCE (3) from it, so the camera's tile keeps y below about
+* cosh(3) and visible positions stay small enough to be packed as float32. Colors are packed as RGBA8. */
+
+class TileBatch
+{
+public:
+    unsigned int VAO;
+    unsigned int VBO;
+    unsigned int colorBuffer;
+    unsigned int colorTexture; // GL_TEXTURE_BUFFER view of colorBuffer
+
+    size_t bytesUploaded; // Running total of bytes written to the buffers
+    size_t bytesAsDoubles; // What the same writes would have cost with GL_DOUBLE positions and RGBA32F colors
+
+    TileBatch(int n, int capacity = 256);
+
+    // Give every tile a slot, rewrite slots whose tile changed, and free the slots of tiles that were not passed in
+    void update(const std::vector<Tile*>& tiles);
+
+    // Draw all tiles passed to the last update(). Expects a shader with the "colors" and "tileSize" uniforms in use.
+    void draw(unsigned int textureUnit = 1);
+
+private:
+    int n; // Vertices per slot
+    int capacity; // Number of slots allocated in VBO
+    unsigned int frame; // Incremented every update
+
+    std::vector<Tile*> owners; // Tile occupying each slot, NULL if free
+    std::vector<unsigned int> used; // Frame each slot was last part of an update
+    std::vector<int> freeSlots;
+
+    // Arguments for glMultiDrawArrays
+    std::vector<GLint> firsts;
+    std::vector<GLsizei> counts;
+
+    std::vector<float> staging; // Vertex data for one slot
+
+    void allocate(); // (Re)create the buffers with room for capacity slots
+    void write(Tile* t); // Upload positions and color of a tile into its slot
+};
+
+#endif
@@ -1,138 +1,197 @@
 #include "Vertex.h"
 
-Vertex::Vertex(int k) : k(k) {
-	initialized = false;
-	pos = glm::dvec3(0);
+#include <algorithm>
+
+std::vector<Vertex> Graph::vertices;
+std::vector<glm::dvec3> Graph::positions;
+std::vector<Edge> Graph::edges;
+std::vector<VertexId> Graph::freeVertices;
+std::vector<EdgeId> Graph::freeEdges;
+size_t Graph::allocations = 0;
+size_t Graph::slotsCreated = 0;
+size_t Graph::slotsReused = 0;
+
+// push_back, counting the pushes that reallocate
+template <class T>
+static void push(std::vector<T>& v, const T& value) {
+	if (v.size() == v.capacity())
+		Graph::allocations++;
+	v.push_back(value);
+}
+
+VertexId Graph::addVertex(int k) {
+	assert(k <= MAX_K);
+	Vertex v;
+	v.edges.fill(NO_ID);
+	v.numEdges = 0;
+	v.k = k;
+	v.initialized = false;
+
+	if (!freeVertices.empty()) {
+		VertexId id = freeVertices.back();
+		freeVertices.pop_back();
+		vertices[id] = v;
+		positions[id] = glm::dvec3(0);
+		slotsReused++;
+		return id;
+	}
+	push(vertices, v);
+	push(positions, glm::dvec3(0));
+	slotsCreated++;
+	return (VertexId)(vertices.size() - 1);
 }
 
-Vertex::Vertex(int k, glm::dvec3 loc) : k(k) {
-	initialized = false;
-	clamp(loc);
+VertexId Graph::addVertex(int k, glm::dvec3 loc) {
+	VertexId v = addVertex(k);
+	clamp(v, loc);
+	return v;
 }
 
-void Vertex::setPos(glm::dvec3 loc) {
-	pos = loc;
+EdgeId Graph::addEdge(VertexId v1, VertexId v2) {
+	Edge e;
+	e.tiles.fill(NO_ID);
+	e.numTiles = 0;
+	e.vertex1 = v1;
+	e.vertex2 = v2;
+
+	EdgeId id;
+	if (!freeEdges.empty()) {
+		id = freeEdges.back();
+		freeEdges.pop_back();
+		edges[id] = e;
+		slotsReused++;
+	} else {
+		push(edges, e);
+		id = (EdgeId)(edges.size() - 1);
+		slotsCreated++;
+	}
+	vertices[v1].edges[vertices[v1].numEdges++] = id;
+	vertices[v2].edges[vertices[v2].numEdges++] = id;
+	return id;
 }
 
-glm::dvec3 Vertex::getPos() {
-	return pos;
+void Graph::releaseVertex(VertexId v) {
+	vertices[v].numEdges = 0;
+	vertices[v].k = 0;
+	push(freeVertices, v);
 }
 
-void Vertex::addEdge(Edge* e) {
-	edges.push_back(e);
+void Graph::releaseEdge(EdgeId e) {
+	assert(edges[e].numTiles == 0);
+	edges[e].vertex1 = NO_ID;
+	edges[e].vertex2 = NO_ID;
+	push(freeEdges, e);
 }
 
-Edge* Vertex::next(Edge* e) {
-	int idx = seekEdge(e);
-	return edges.at((idx + 1) % k);
+EdgeId Graph::next(VertexId v, EdgeId e) {
+	int idx = seekEdge(v, e);
+	return vertices[v].edges[(idx + 1) % vertices[v].k];
 }
 
-Edge* Vertex::prev(Edge* e) {
-	int idx = seekEdge(e);
-	return edges.at((idx - 1 + k) % k);
+EdgeId Graph::prev(VertexId v, EdgeId e) {
+	int k = vertices[v].k;
+	int idx = seekEdge(v, e);
+	return vertices[v].edges[(idx - 1 + k) % k];
 }
 
-void Vertex::clamp(glm::dvec3 loc) {
-	assert(!initialized);
-	initialized = true;
-	pos = loc;
-	int start = edges.size();
+void Graph::clamp(VertexId v, glm::dvec3 loc) {
+	assert(!vertices[v].initialized);
+	vertices[v].initialized = true;
+	positions[v] = loc;
+	int k = vertices[v].k;
+	int start = vertices[v].numEdges;
 	for (int i = start; i < k; i++) {
-		Vertex* loose_vert = new Vertex(k);
-		Edge* loose_edge = new Edge(this, loose_vert);
+		VertexId loose_vert = addVertex(k);
+		addEdge(v, loose_vert);
 	}
 }
 
-void Vertex::replaceEdge(Edge* oldEdge, Edge* newEdge) {
-	int idx = seekEdge(oldEdge);
-	edges.at(idx) = newEdge;
-	delete oldEdge;
+void Graph::replaceEdge(VertexId v, EdgeId oldEdge, EdgeId newEdge) {
+	int idx = seekEdge(v, oldEdge);
+	vertices[v].edges[idx] = newEdge;
 }
 
-int Vertex::seekEdge(Edge* e) {
-	auto it = std::find(edges.begin(), edges.end(), e);
-	assert(it != edges.end());
-	return it - edges.begin();
+int Graph::seekEdge(VertexId v, EdgeId e) {
+	const Vertex& vert = vertices[v];
+	auto it = std::find(vert.edges.begin(), vert.edges.begin() + vert.numEdges, e);
+	assert(it != vert.edges.begin() + vert.numEdges);
+	return it - vert.edges.begin();
 }
 
-Edge* Vertex::seekVertex(Vertex* v) {
-	for (Edge* e : edges) {
-		if (e->vertex1 == v || e->vertex2 == v)
-			return e;
+EdgeId Graph::seekVertex(VertexId v, VertexId w) {
+	const Vertex& vert = vertices[v];
+	for (int i = 0; i < vert.numEdges; i++) {
+		const Edge& e = edges[vert.edges[i]];
+		if (e.vertex1 == w || e.vertex2 == w)
+			return vert.edges[i];
 	}
 	assert(false);
-	return NULL;
+	return NO_ID;
 }
 
 /*********************************************************************/
 
-Edge::Edge(Vertex* v1, Vertex* v2) : vertex1(v1), vertex2(v2) {
-	v1->addEdge(this);
-	v2->addEdge(this);
-}
-
-std::vector<Vertex*> Edge::verts() {
-	std::vector<Vertex*> v{ vertex1, vertex2 };
-	return v;
-}
-
-void Edge::addTile(Tile* t) {
-	if (tiles.size() == 2)
+void Graph::addTile(EdgeId e, TileId t) {
+	Edge& edge = edges[e];
+	if (std::find(edge.tiles.begin(), edge.tiles.begin() + edge.numTiles, t) != edge.tiles.begin() + edge.numTiles)
+		std::cout << "DUPLICATE TILE" << std::endl;
+	else if (edge.numTiles == 2)
 		std::cout << "2 TILES" << std::endl;
-	if (std::find(tiles.begin(), tiles.end(), t) == tiles.end())
-		tiles.push_back(t);
 	else
-		std::cout << "DUPLICATE TILE" << std::endl;
+		edge.tiles[edge.numTiles++] = t;
 }
 
-std::vector<Vertex*> Edge::verts(glm::dvec3 center) {
+std::array<VertexId, 2> Graph::verts(EdgeId e, glm::dvec3 center) {
+	VertexId vertex1 = edges[e].vertex1;
+	VertexId vertex2 = edges[e].vertex2;
 
-	glm::dvec3 v1 = getPoincare(vertex1->getPos()) - getPoincare(center);
-	glm::dvec3 v2 = getPoincare(vertex2->getPos()) - getPoincare(center);
+	glm::dvec3 v1 = getPoincare(positions[vertex1]) - getPoincare(center);
+	glm::dvec3 v2 = getPoincare(positions[vertex2]) - getPoincare(center);
 	double rad1 = atan2(v1[2], v1[0]);
 	double rad2 = atan2(v2[2], v2[0]);
 
 	double angle = fmod(rad2 - rad1 + 2 * M_PI, 2 * M_PI);
 
-	if (angle > M_PI) {
-		std::vector<Vertex*> v{ vertex2, vertex1 };
-		return v;
-	} else {
-		std::vector<Vertex*> v{ vertex1, vertex2 };
-		return v;
-	}
+	if (angle > M_PI)
+		return { vertex2, vertex1 };
+	else
+		return { vertex1, vertex2 };
 }
 
-bool Edge::hasDangling() {
-	return (!vertex1->initialized) || (!vertex2->initialized);
+bool Graph::hasDangling(EdgeId e) {
+	return (!vertices[edges[e].vertex1].initialized) || (!vertices[edges[e].vertex2].initialized);
 }
 
-void Edge::merge(Edge* e) {
-	assert(this->hasDangling() && e->hasDangling());
-	Vertex* old_dangling;
-	Vertex* other_dangling;
-	if (!vertex1->initialized) {
-		old_dangling = vertex1;
-		if (!e->vertex1->initialized) {
-			vertex1 = e->vertex2;
-			other_dangling = e->vertex1;
+// Join e's loose end to other's placed vertex. Edge other and both placeholder vertices are released.
+void Graph::merge(EdgeId e, EdgeId other) {
+	assert(hasDangling(e) && hasDangling(other));
+	Edge& edge = edges[e];
+	const Edge& o = edges[other];
+	VertexId old_dangling;
+	VertexId other_dangling;
+	if (!vertices[edge.vertex1].initialized) {
+		old_dangling = edge.vertex1;
+		if (!vertices[o.vertex1].initialized) {
+			edge.vertex1 = o.vertex2;
+			other_dangling = o.vertex1;
 		} else {
-			vertex1 = e->vertex1;
-			other_dangling = e->vertex2;
+			edge.vertex1 = o.vertex1;
+			other_dangling = o.vertex2;
 		}
-		vertex1->replaceEdge(e, this);
+		replaceEdge(edge.vertex1, other, e);
 	}
 	else {
-		old_dangling = vertex2;
-		if (!e->vertex1->initialized) {
-			vertex2 = e->vertex2;
-			other_dangling = e->vertex1;
+		old_dangling = edge.vertex2;
+		if (!vertices[o.vertex1].initialized) {
+			edge.vertex2 = o.vertex2;
+			other_dangling = o.vertex1;
 		} else {
-			vertex2 = e->vertex1;
-			other_dangling = e->vertex2;
+			edge.vertex2 = o.vertex1;
+			other_dangling = o.vertex2;
 		}
-		vertex2->replaceEdge(e, this);
+		replaceEdge(edge.vertex2, other, e);
 	}
-	delete old_dangling;
-	delete other_dangling;
-}
\ No newline at end of file
+	releaseVertex(old_dangling);
+	releaseVertex(other_dangling);
+	releaseEdge(other);
+}
@@ -1,44 +1,72 @@
 #pragma once
 
 #include "hyper.h"
+#include <array>
 #include <vector>
 #include <iostream>
+#include <stdint.h>
 
-class Edge;
-class Tile;
+/* The tiling graph is stored in contiguous arenas (see Graph below) and linked by 32-bit indices.
+* Vertex and Edge only hold topology, in fixed-size arrays; vertex positions live in their own array
+* so that layout and culling can walk positions without touching adjacency. */
 
-class Vertex
+typedef uint32_t VertexId;
+typedef uint32_t EdgeId;
+typedef uint32_t TileId;
+
+const uint32_t NO_ID = 0xFFFFFFFF;
+const int MAX_N = 8; // Max vertices per tile
+const int MAX_K = 8; // Max tiles (and edges) per vertex
+
+struct Vertex
 {
-public:
-    int k; // Number of edges per vertex.
-    std::vector<Edge*> edges;
-    glm::dvec3 pos;
-    bool initialized;
-
-    Vertex(int k);
-    Vertex(int k, glm::dvec3 loc);
-    void setPos(glm::dvec3 loc);
-    glm::dvec3 getPos();
-    void addEdge(Edge* e);
-    Edge* next(Edge* e); // Get next edge in counter clockwise order.
-    Edge* prev(Edge* e); // Get prev edge in ccw order (i.e. next edge in clockwise order).
-    void clamp(glm::dvec3 loc);
-    void replaceEdge(Edge* oldEdge, Edge* newEdge);
-    int seekEdge(Edge* e); // Find index of given edge in the vector of edges.
-    Edge* seekVertex(Vertex* v); // Find edge connecting this vertex to the given one.
+    std::array<EdgeId, MAX_K> edges; // CCW order, first numEdges are set
+    uint8_t numEdges;
+    uint8_t k; // Number of edges per vertex.
+    bool initialized; // False for the placeholder at the loose end of an edge
+};
+
+struct Edge
+{
+    std::array<TileId, 2> tiles; // First numTiles are set
+    uint8_t numTiles;
+    VertexId vertex1;
+    VertexId vertex2;
 };
 
-class Edge
+class Graph
 {
 public:
-    std::vector<Tile*> tiles;
-    Vertex* vertex1;
-    Vertex* vertex2;
-
-    Edge(Vertex* v1, Vertex* v2);
-    void addTile(Tile* t);
-    std::vector<Vertex*> verts();
-    std::vector<Vertex*> verts(glm::dvec3 center); // Get vertices in ccw order relative to given center
-    bool hasDangling();
-    void merge(Edge* e);
+    static std::vector<Vertex> vertices;
+    static std::vector<glm::dvec3> positions; // Indexed by VertexId
+    static std::vector<Edge> edges;
+
+    // Slots released by merge(), reused before the arenas grow
+    static std::vector<VertexId> freeVertices;
+    static std::vector<EdgeId> freeEdges;
+
+    static size_t allocations; // Pushes onto the arenas or free lists that had to reallocate
+    static size_t slotsCreated; // Vertex and edge slots appended to the arenas
+    static size_t slotsReused; // Vertex and edge slots taken from the free lists
+
+    static VertexId addVertex(int k); // Placeholder vertex, not yet placed
+    static VertexId addVertex(int k, glm::dvec3 loc); // Placed vertex, with loose edges filling its remaining slots
+    static EdgeId addEdge(VertexId v1, VertexId v2);
+    static void releaseVertex(VertexId v); // Put an unused vertex on the free list
+    static void releaseEdge(EdgeId e); // Put an unused edge on the free list
+
+    static glm::dvec3 getPos(VertexId v) { return positions[v]; }
+    static void setPos(VertexId v, glm::dvec3 loc) { positions[v] = loc; }
+    static EdgeId next(VertexId v, EdgeId e); // Get next edge in counter clockwise order.
+    static EdgeId prev(VertexId v, EdgeId e); // Get prev edge in ccw order (i.e. next edge in clockwise order).
+    static void clamp(VertexId v, glm::dvec3 loc);
+    static void replaceEdge(VertexId v, EdgeId oldEdge, EdgeId newEdge);
+    static int seekEdge(VertexId v, EdgeId e); // Find index of given edge in the vertex's edges.
+    static EdgeId seekVertex(VertexId v, VertexId w); // Find edge connecting v to w.
+
+    static void addTile(EdgeId e, TileId t);
+    static VertexId other(EdgeId e, VertexId v) { return (edges[e].vertex1 == v) ? edges[e].vertex2 : edges[e].vertex1; }
+    static std::array<VertexId, 2> verts(EdgeId e, glm::dvec3 center); // Get vertices in ccw order relative to given center
+    static bool hasDangling(EdgeId e);
+    static void merge(EdgeId e, EdgeId other);
 };
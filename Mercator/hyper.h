@@ -100,24 +100,137 @@ static double circleRadius(int n, int k)
     return sqrt((tan(M_PI/2 - M_PI/k) - tan(M_PI/n)) / (tan(M_PI/2 - M_PI/k) + tan(M_PI/n)));
 }
 
+/*******************
+* Isometries of the hyperboloid, stored as 3x3 Lorentz matrices: M^T J M = J, where J = diag(-1, 1, -1)
+* is the metric used by minkDot. Composing isometries is a matrix product, so a chain of translations
+* and rotations can be built once and then applied to any number of points.
+********************/
+
+class Isometry
+{
+public:
+    glm::dmat3 m;
+
+    Isometry() : m(1.0), depth(0) {}
+    explicit Isometry(const glm::dmat3& m) : m(m), depth(0) {}
+
+    // Composition: (a * b) * v == a * (b * v).
+    // Rounding error accumulates with every product, so long chains are re-orthonormalized periodically.
+    Isometry operator*(const Isometry& other) const
+    {
+        Isometry result(m * other.m);
+        result.depth = depth + other.depth + 1;
+        if (result.depth >= RENORMALIZE_PERIOD)
+            result.reorthonormalize();
+        return result;
+    }
+
+    glm::dvec3 operator*(glm::dvec3 v) const
+    {
+        return m * v;
+    }
+
+    // Apply to count points in place
+    void apply(glm::dvec3* points, size_t count) const
+    {
+        for (size_t i = 0; i < count; i++)
+            points[i] = m * points[i];
+    }
+
+    // Inverse of a Lorentz matrix is J M^T J
+    Isometry inverse() const
+    {
+        glm::dmat3 J(glm::dvec3(-1, 0, 0), glm::dvec3(0, 1, 0), glm::dvec3(0, 0, -1));
+        Isometry result(J * glm::transpose(m) * J);
+        result.depth = depth;
+        return result;
+    }
+
+    // Minkowski Gram-Schmidt on the columns: the image of (0,1,0) is kept on the hyperboloid,
+    // and the images of the x and z axes are made unit spacelike vectors orthogonal to it and each other.
+    void reorthonormalize()
+    {
+        glm::dvec3 y = m[1] / sqrt(minkDot(m[1], m[1]));
+        glm::dvec3 x = m[0] - y * minkDot(m[0], y);
+        x /= sqrt(-minkDot(x, x));
+        glm::dvec3 z = m[2] - y * minkDot(m[2], y) + x * minkDot(m[2], x);
+        z /= sqrt(-minkDot(z, z));
+        m = glm::dmat3(x, y, z);
+        depth = 0;
+    }
+
+    // Translation in x-direction
+    static Isometry translateX(double dist)
+    {
+        double co = cosh(dist);
+        double si = sinh(dist);
+        return Isometry(glm::dmat3(glm::dvec3(co, si, 0), glm::dvec3(si, co, 0), glm::dvec3(0, 0, 1)));
+    }
+
+    // Translation in z-direction
+    static Isometry translateZ(double dist)
+    {
+        double co = cosh(dist);
+        double si = sinh(dist);
+        return Isometry(glm::dmat3(glm::dvec3(1, 0, 0), glm::dvec3(0, co, si), glm::dvec3(0, si, co)));
+    }
+
+    // Symmetric translation in both directions (see the note above translateXZ below)
+    static Isometry translateXZ(double xdist, double zdist)
+    {
+        double sx = sinh(xdist);
+        double sz = sinh(zdist);
+        double a = sx * sx;
+        double b = sz * sz;
+        double fx = acosh(sqrt((1 + a) / (1 - a * b)));
+        return translateZ(zdist) * translateX(xdist > 0 ? fx : -fx);
+    }
+
+    // XZ translation that preserves x and z. I.e. translating x and z from the origin gets (x, _, z).
+    static Isometry translateXZ2(double x, double z)
+    {
+        double xdist = asinh(x);
+        double zdist = asinh(z / cosh(xdist));
+        return translateZ(zdist) * translateX(xdist);
+    }
+
+    // Counter-clockwise rotation about the y-axis
+    static Isometry rotate(double angle)
+    {
+        double c = cos(angle);
+        double s = sin(angle);
+        return Isometry(glm::dmat3(glm::dvec3(c, 0, s), glm::dvec3(0, 1, 0), glm::dvec3(-s, 0, c)));
+    }
+
+    // Reflection in the line with unit spacelike normal u (minkDot(u, u) == -1): x -> x + 2 * minkDot(x, u) * u.
+    // Same map as symmetry() in the line between p and q, with u = (p - q) / sqrt(-hypEval(p - q)).
+    static Isometry reflection(glm::dvec3 u)
+    {
+        glm::dvec3 Ju(-u.x, u.y, -u.z);
+        return Isometry(glm::dmat3(1.0) + 2.0 * glm::outerProduct(u, Ju));
+    }
+
+private:
+    static const int RENORMALIZE_PERIOD = 16;
+    int depth; // Products since the last re-orthonormalization
+};
+
 /*******************
 * Note on translations: do in reverse order. I.e. to get RUL, do left -> up -> right translations.
+* The functions below move a single vector. To move many points by the same amount, build the
+* Isometry once and apply it to all of them instead.
 ********************/
 
 // Translate vector in x-direction
 static glm::dvec3 translateX(glm::dvec3 v, double dist)
 {
-    double co = cosh(dist);
-    double si = sinh(dist);
-    return glm::dvec3(co * v.x + si * v.y, si * v.x + co * v.y, v.z);
+    return Isometry::translateX(dist) * v;
 }
 
 // Translate vector in z-direction
 static glm::dvec3 translateZ(glm::dvec3 v, double dist)
 {
-    double co = cosh(dist);
-    double si = sinh(dist);
-    return glm::dvec3(v.x, si * v.z + co * v.y, co * v.z + si * v.y);
+    return Isometry::translateZ(dist) * v;
 }
 
 // To find a symmetric translation, from (0,1,0), find x->z, and find z->x, for any variable x,z.
@@ -137,29 +250,13 @@ static glm::dvec3 translateZ(glm::dvec3 v, double dist)
 // Translate vector in both directions
 static glm::dvec3 translateXZ(glm::dvec3 v, double xdist, double zdist)
 {
-    double a = pow(sinh(xdist), 2.0f);
-    double b = pow(sinh(zdist), 2.0f);
-    double fx = acosh(sqrt((1 + a) / (1 - a*b)));
-    if (xdist > 0)
-        v = translateX(v, fx);
-    else
-        v = translateX(v, -fx);
-    v = translateZ(v, zdist);
-    return v;
+    return Isometry::translateXZ(xdist, zdist) * v;
 }
 
 // Reverse translateXZ
 static glm::dvec3 reverseXZ(glm::dvec3 v, double xdist, double zdist)
 {
-    double a = pow(sinh(xdist), 2.0f);
-    double b = pow(sinh(zdist), 2.0f);
-    double fx = acosh(sqrt((1 + a) / (1 - a * b)));
-    v = translateZ(v, -zdist);
-    if (xdist > 0)
-        v = translateX(v, -fx);
-    else
-        v = translateX(v, fx);
-    return v;
+    return Isometry::translateXZ(xdist, zdist).inverse() * v;
 }
 
 // Get x and z for translateXZ from vector v. translateXZ(origin, x, z) will give v.
@@ -182,21 +279,13 @@ static glm::dvec3 getXZ(glm::dvec3 v)
 // XZ translation that preserves x and z. I.e. translating x and z from the origin gets (x, _, z).
 static glm::dvec3 translateXZ2(glm::dvec3 v, double x, double z)
 {
-    double xdist = asinh(x);
-    v = translateX(v, xdist);
-    double zdist = asinh(z / cosh(xdist));
-    v = translateZ(v, zdist);
-    return v;
+    return Isometry::translateXZ2(x, z) * v;
 }
 
 // Reverse of XZ2. Will reverse a translateXZ2 call given the same x and z.
 static glm::dvec3 reverseXZ2(glm::dvec3 v, double x, double z)
 {
-    double xdist = asinh(x);
-    double zdist = asinh(z / cosh(xdist));
-    v = translateZ(v, -zdist);
-    v = translateX(v, -xdist);
-    return v;
+    return Isometry::translateXZ2(x, z).inverse() * v;
 }
 
 // Get hyperboloid coordinates from x/z pair
@@ -224,7 +313,7 @@ static bool close(glm::dvec3 a, glm::dvec3 b)
 // Counter-clockwise rotation, preserving y
 static glm::dvec3 rotate(glm::dvec3 v, double angle)
 {
-    return glm::dvec3(v.x * cos(angle) - v.z * sin(angle), v.y, v.x * sin(angle) + v.z * cos(angle));
+    return Isometry::rotate(angle) * v;
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,195 @@
+#include "hyperBatch.h"
+
+#include <stdint.h>
+#include <assert.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define HYPER_BATCH_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+/*******************
+* Each instruction set gets its own copy of the kernels in hyperBatchKernels.inl, instantiated through
+* the BATCH_* macros. On GCC and Clang, the vector copies are compiled with target pragmas so the rest
+* of the program doesn't need -mavx2; MSVC accepts the intrinsics without any flags.
+********************/
+
+// Scalar
+#define BATCH_NAME(f) f##Scalar
+#define BATCH_V double
+#define BATCH_WIDTH 1
+#define BATCH_LOAD(p) (*(p))
+#define BATCH_SET1(a) (a)
+#define BATCH_ADD(a, b) ((a) + (b))
+#define BATCH_MUL(a, b) ((a) * (b))
+#define BATCH_DIV(a, b) ((a) / (b))
+#define BATCH_LTMASK(a, b) ((unsigned int)((a) < (b)))
+#include "hyperBatchKernels.inl"
+#undef BATCH_NAME
+#undef BATCH_V
+#undef BATCH_WIDTH
+#undef BATCH_LOAD
+#undef BATCH_SET1
+#undef BATCH_ADD
+#undef BATCH_MUL
+#undef BATCH_DIV
+#undef BATCH_LTMASK
+
+#ifdef HYPER_BATCH_X86
+
+// AVX2, 4 doubles per vector
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#elif defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,fma"))), apply_to = function)
+#endif
+#define BATCH_NAME(f) f##Avx2
+#define BATCH_V __m256d
+#define BATCH_WIDTH 4
+#define BATCH_LOAD(p) _mm256_loadu_pd(p)
+#define BATCH_SET1(a) _mm256_set1_pd(a)
+#define BATCH_ADD(a, b) _mm256_add_pd(a, b)
+#define BATCH_MUL(a, b) _mm256_mul_pd(a, b)
+#define BATCH_DIV(a, b) _mm256_div_pd(a, b)
+#define BATCH_LTMASK(a, b) ((unsigned int)_mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LT_OQ)))
+#include "hyperBatchKernels.inl"
+#undef BATCH_NAME
+#undef BATCH_V
+#undef BATCH_WIDTH
+#undef BATCH_LOAD
+#undef BATCH_SET1
+#undef BATCH_ADD
+#undef BATCH_MUL
+#undef BATCH_DIV
+#undef BATCH_LTMASK
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#elif defined(__clang__)
+#pragma clang attribute pop
+#endif
+
+// AVX-512, 8 doubles per vector
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#elif defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f"))), apply_to = function)
+#endif
+#define BATCH_NAME(f) f##Avx512
+#define BATCH_V __m512d
+#define BATCH_WIDTH 8
+#define BATCH_LOAD(p) _mm512_loadu_pd(p)
+#define BATCH_SET1(a) _mm512_set1_pd(a)
+#define BATCH_ADD(a, b) _mm512_add_pd(a, b)
+#define BATCH_MUL(a, b) _mm512_mul_pd(a, b)
+#define BATCH_DIV(a, b) _mm512_div_pd(a, b)
+#define BATCH_LTMASK(a, b) ((unsigned int)_mm512_cmp_pd_mask(a, b, _CMP_LT_OQ))
+#include "hyperBatchKernels.inl"
+#undef BATCH_NAME
+#undef BATCH_V
+#undef BATCH_WIDTH
+#undef BATCH_LOAD
+#undef BATCH_SET1
+#undef BATCH_ADD
+#undef BATCH_MUL
+#undef BATCH_DIV
+#undef BATCH_LTMASK
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#elif defined(__clang__)
+#pragma clang attribute pop
+#endif
+
+#endif // HYPER_BATCH_X86
+
+// One entry per instruction set
+struct BatchKernels
+{
+    const char* name;
+    size_t (*withinRadius)(const double*, const double*, const double*, const double*, size_t, double, unsigned char*);
+};
+
+#define BATCH_KERNELS(name, suffix) \
+    { name, withinRadius##suffix }
+
+#ifdef HYPER_BATCH_X86
+// Whether the CPU and the OS (which has to save the wider registers) both support AVX2 or AVX-512F
+static bool cpuSupports(bool avx512)
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool fma = (info[2] & (1 << 12)) != 0;
+    if (!osxsave)
+        return false;
+    uint64_t xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    if (avx512)
+        return (xcr0 & 0xE6) == 0xE6 && (info[1] & (1 << 16)) != 0;
+    return (xcr0 & 0x6) == 0x6 && fma && (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    if (avx512)
+        return __builtin_cpu_supports("avx512f");
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+#endif
+
+#ifdef HYPER_BATCH_X86
+#ifndef NDEBUG
+// Whether the kernels give the same answers as the scalar ones, on points spiralling out past the radius.
+// The count is not a multiple of any vector width, so the remainder loops are covered too.
+static bool matchesScalar(const BatchKernels& chosen)
+{
+    HypPoints points;
+    for (int i = 0; i < 101; i++)
+        points.push_back(Isometry::rotate(2.4 * i) * reversePoincare(0.95 * i / 101, 0));
+    Isometry iso = Isometry::translateXZ(0.3, -0.2) * Isometry::rotate(0.7);
+
+    std::vector<unsigned char> expected(points.size()), inside(points.size());
+    size_t expectedTotal = withinRadiusScalar(&iso.m[0][0], points.x.data(), points.y.data(), points.z.data(), points.size(), 0.75, expected.data());
+    size_t total = chosen.withinRadius(&iso.m[0][0], points.x.data(), points.y.data(), points.z.data(), points.size(), 0.75, inside.data());
+    return total == expectedTotal && inside == expected;
+}
+#endif
+
+// Debug builds check the vector kernels against the scalar ones
+static const BatchKernels& checked(const BatchKernels& chosen)
+{
+    assert(matchesScalar(chosen));
+    return chosen;
+}
+#endif
+
+// Picked on first use
+static const BatchKernels& kernels()
+{
+    static const BatchKernels scalar = BATCH_KERNELS("scalar", Scalar);
+#ifdef HYPER_BATCH_X86
+    static const BatchKernels avx2 = BATCH_KERNELS("avx2", Avx2);
+    static const BatchKernels avx512 = BATCH_KERNELS("avx512", Avx512);
+    static const BatchKernels& chosen = checked(cpuSupports(true) ? avx512 : cpuSupports(false) ? avx2 : scalar);
+    return chosen;
+#else
+    return scalar;
+#endif
+}
+
+const char* batchKernelName()
+{
+    return kernels().name;
+}
+
+size_t batchWithinRadius(const Isometry& iso, const HypPoints& points, double rad, unsigned char* inside)
+{
+    return kernels().withinRadius(&iso.m[0][0], points.x.data(), points.y.data(), points.z.data(), points.size(), rad, inside);
+}
@@ -0,0 +1,45 @@
+#ifndef HYPERBATCH_H
+#define HYPERBATCH_H
+
+#include "hyper.h"
+#include <vector>
+
+/*******************
+* Batch versions of the hyper.h functions, working on structure-of-arrays buffers.
+* Only the visibility test runs over enough points at once to be worth batching; relayout places
+* n - 2 vertices per tile, each tile with its own reflection, so it stays on the scalar hyper.h calls.
+* The kernels are vectorized with AVX2 or AVX-512 when the CPU supports them; the instruction set
+* is picked once at runtime, with a scalar fallback (see hyperBatch.cpp and hyperBatchKernels.inl).
+********************/
+
+// Points stored as separate x, y and z arrays
+struct HypPoints
+{
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<double> z;
+
+    size_t size() const { return x.size(); }
+
+    void clear()
+    {
+        x.clear();
+        y.clear();
+        z.clear();
+    }
+
+    void push_back(glm::dvec3 v)
+    {
+        x.push_back(v.x);
+        y.push_back(v.y);
+        z.push_back(v.z);
+    }
+};
+
+// Name of the instruction set the kernels run with ("avx512", "avx2" or "scalar")
+const char* batchKernelName();
+
+// inside[i] = whether getPoincare(iso * points[i]) is within rad of the origin. Returns how many are.
+size_t batchWithinRadius(const Isometry& iso, const HypPoints& points, double rad, unsigned char* inside);
+
+#endif
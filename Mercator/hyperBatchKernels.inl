@@ -0,0 +1,42 @@
+// Kernel bodies shared by every instruction set. hyperBatch.cpp includes this file once per
+// instruction set, after defining:
+//   BATCH_NAME(f)   name of the kernel f for this instruction set
+//   BATCH_V         vector type, BATCH_WIDTH doubles wide
+//   BATCH_LOAD, BATCH_SET1, BATCH_ADD, BATCH_MUL, BATCH_DIV
+//   BATCH_LTMASK(a, b)   bitmask with bit j set if lane j of a is less than lane j of b
+// Each kernel runs the vector loop over whole vectors and finishes the remainder with scalar code.
+
+static size_t BATCH_NAME(withinRadius)(const double* m, const double* x, const double* y, const double* z, size_t count, double rad, unsigned char* inside)
+{
+    BATCH_V m00 = BATCH_SET1(m[0]), m01 = BATCH_SET1(m[1]), m02 = BATCH_SET1(m[2]);
+    BATCH_V m10 = BATCH_SET1(m[3]), m11 = BATCH_SET1(m[4]), m12 = BATCH_SET1(m[5]);
+    BATCH_V m20 = BATCH_SET1(m[6]), m21 = BATCH_SET1(m[7]), m22 = BATCH_SET1(m[8]);
+    BATCH_V one = BATCH_SET1(1.0);
+    BATCH_V rad2 = BATCH_SET1(rad * rad);
+    size_t total = 0;
+    size_t i = 0;
+    for (; i + BATCH_WIDTH <= count; i += BATCH_WIDTH) {
+        BATCH_V vx = BATCH_LOAD(x + i), vy = BATCH_LOAD(y + i), vz = BATCH_LOAD(z + i);
+        BATCH_V hx = BATCH_ADD(BATCH_ADD(BATCH_MUL(m00, vx), BATCH_MUL(m10, vy)), BATCH_MUL(m20, vz));
+        BATCH_V hy = BATCH_ADD(BATCH_ADD(BATCH_MUL(m01, vx), BATCH_MUL(m11, vy)), BATCH_MUL(m21, vz));
+        BATCH_V hz = BATCH_ADD(BATCH_ADD(BATCH_MUL(m02, vx), BATCH_MUL(m12, vy)), BATCH_MUL(m22, vz));
+        BATCH_V y1 = BATCH_ADD(hy, one);
+        BATCH_V px = BATCH_DIV(hx, y1);
+        BATCH_V pz = BATCH_DIV(hz, y1);
+        unsigned int mask = BATCH_LTMASK(BATCH_ADD(BATCH_MUL(px, px), BATCH_MUL(pz, pz)), rad2);
+        for (int j = 0; j < BATCH_WIDTH; j++) {
+            inside[i + j] = (mask >> j) & 1;
+            total += inside[i + j];
+        }
+    }
+    for (; i < count; i++) {
+        double hx = m[0] * x[i] + m[3] * y[i] + m[6] * z[i];
+        double hy = m[1] * x[i] + m[4] * y[i] + m[7] * z[i];
+        double hz = m[2] * x[i] + m[5] * y[i] + m[8] * z[i];
+        double px = hx / (hy + 1);
+        double pz = hz / (hy + 1);
+        inside[i] = px * px + pz * pz < rad * rad;
+        total += inside[i];
+    }
+    return total;
+}
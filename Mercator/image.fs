@@ -1,11 +1,11 @@
 #version 330 core
 
-in vec2 TexCoords;
+in vec3 TexCoords;
 
 out vec4 FragColor;
-uniform sampler2D texture1;
+uniform sampler2DArray images;
 
 void main()
 {
-    FragColor = texture(texture1, TexCoords);
+    FragColor = texture(images, TexCoords);
 }
\ No newline at end of file
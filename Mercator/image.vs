@@ -2,15 +2,32 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec3 aCenter; // Tile center on the hyperboloid, per instance
+layout (location = 4) in int aLayer; // Texture array layer, per instance
 
-out vec2 TexCoords;
+out vec3 TexCoords;
 
-uniform mat4 model;
+uniform mat3 isometry; // Camera translation, as a Lorentz transform
+uniform float scale;
 uniform mat4 view;
 uniform mat4 projection;
 
 void main()
 {
-    TexCoords = aTexCoords;
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    // Poincare projection of the tile center as seen from the camera
+    vec3 hyp = isometry * aCenter;
+    vec3 center = vec3(hyp.x / (hyp.y + 1.0), 0.0, hyp.z / (hyp.y + 1.0));
+
+    // Turn the quad about the y-axis to face the origin
+    float angle = radians(90.0);
+    if (center.x != 0.0 || center.z != 0.0)
+        angle += atan(center.z, -center.x);
+    float c = cos(angle);
+    float s = sin(angle);
+    mat3 rotation = mat3(vec3(c, 0.0, -s), vec3(0.0, 1.0, 0.0), vec3(s, 0.0, c));
+
+    vec3 pos = center + scale * (vec3(0.0, 1.0, 0.0) + rotation * aPos);
+
+    TexCoords = vec3(aTexCoords, aLayer);
+    gl_Position = projection * view * vec4(pos, 1.0);
 }
\ No newline at end of file
@@ -1,6 +1,5 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
-#include "stb_image.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -8,10 +7,14 @@
 #include "Shader.h"
 #include "Camera.h"
 #include "Tile.h"
+#include "TileBatch.h"
+#include "ImageBatch.h"
+#include "GenClient.h"
+#include "GenScheduler.h"
 
 #include <iostream>
 #include <string>
-#include <thread>
+#include <map>
 #include <cstdio>
 #include <math.h>
 
@@ -22,13 +25,12 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow* window);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
-unsigned int loadTexture(const char* path);
 
 // Print glm::dvec3
 void printVec(glm::dvec3 v);
 
-void setArray(double arr[], glm::dvec3 v, int ind);
-void setAllVertices(double arr[], Tile* T);
+// Print average frame time and bytes uploaded per frame
+void printStats(double elapsed, unsigned int frames, size_t bytes, size_t bytesAsDoubles, size_t tested, const GenStats& gen);
 
 // Screen settings
 unsigned int SCR_WIDTH = 1280;
@@ -44,31 +46,55 @@ double deltaTime = 0.0f; // Time between current frame and last frame
 double lastFrame = 0.0f; // Time of last frame
 double changed = 0.0f;   // Time of last tile change
 
-// Limit the max number of threads (performance will tank otherwise)
-const unsigned int MAX_THREADS = 1;
-unsigned int numThreads = 0;
+// Benchmark: periodically print frame time and vertex upload traffic. The "as doubles" figure is computed
+// from the same writes, not measured; it is what they would have cost in the previous GL_DOUBLE formats.
+const bool PRINT_STATS = false;
+const double STATS_INTERVAL = 5.0;
+double statsStart = 0.0f;
+unsigned int statsFrames = 0;
+size_t statsBytes = 0;
+size_t statsBytesAsDoubles = 0;
+size_t statsTested = 0;
+size_t statsPrefetched = 0; // Images generated for prefetched megatiles
+size_t statsPrefetchHits = 0; // Of those, images whose tile has since been visible
+double statsImageWait = 0; // Time from forming a megatile to showing its images, summed over megatiles
+size_t statsImages = 0;
+
+// Images come back in the response; also keep PNGs in world_data/images (written by the server in the background)
+const bool SAVE_IMAGES = true;
 
 // Static vectors for tracking tiles
+deque<Tile> Tile::arena;
 vector<Tile*> Tile::visible;
 vector<Tile*> Tile::next;
-vector<Tile*> Tile::all;
 queue<Tile*> Tile::parents;
+Isometry Tile::isometry;
+Tile* Tile::origin = NULL;
+unsigned int Tile::layout = 0;
+Isometry Tile::frame;
+unsigned int Tile::epoch = 1;
+vector<Tile*> Tile::ring;
+size_t Tile::tested = 0;
 
 // Number of edges per tile and number of tiles per vertex
 const int n = 4;
 const int k = 5;
 const double rad = circleRadius(n, k);
 
-// Call python script to generate image; run in parallel to OpenGL
-void genImg(vector<Tile*> t, vector<Tile*> worldTiles, unsigned int ind);
+// Build the request for a megatile and number its tiles; the client sends it in parallel to OpenGL
+GenRequest genRequest(const vector<Tile*>& mega, const vector<Tile*>& worldTiles, unsigned int ind);
 
 // Manage image generations
 size_t index1 = 1; // tile1.png, tile2.png, ...
-queue<vector<Tile*>> waiting;
-queue<glm::vec3> coords;
-queue<vector<Tile*>> pending;
+GenScheduler waiting;
+map<uint64_t, Megatile> generating; // Megatiles by request id
 
-vector<thread> allThreads;
+// Prefetch megatiles on the path the camera will cover in this many seconds at its current velocity
+const double PREFETCH_HORIZON = 3.0;
+vector<Tile*> prefetchedTiles; // Tiles with a prefetched image that haven't been visible yet
+
+// Time per frame spent uploading finished images; the rest wait for the next frame
+const double UPLOAD_BUDGET = 0.004;
 
 void error_callback(int error, const char* msg) {
     std::string s;
@@ -123,19 +149,6 @@ int main() {
     Shader shader("shader.vs", "shader.fs");
     Shader imageShader("image.vs", "image.fs");
 
-    double vertices[] = {
-        // positions         // normals        // texture coords
-         1.0,  1.0, 0.0,  0.0, 1.0, 0.0,  1.0, 0.0,
-        -1.0,  1.0, 0.0,  0.0, 1.0, 0.0,  0.0, 0.0,
-        -1.0, -1.0, 0.0,  0.0, 1.0, 0.0,  0.0, 1.0,
-
-         1.0,  1.0, 0.0,  0.0, 1.0, 0.0,  1.0, 0.0,
-        -1.0, -1.0, 0.0,  0.0, 1.0, 0.0,  0.0, 1.0,
-         1.0, -1.0, 0.0,  0.0, 1.0, 0.0,  1.0, 1.0
-    };
-
-    double planeVertices[3 * (n - 2) * 8] = { 0.0 };
-    
     /*
     double planeVertices[] = {
         // positions         // normals         // texcoords
@@ -149,45 +162,23 @@ int main() {
     };
     */
 
-    // Plane VAO/VBO
-    unsigned int planeVAO, planeVBO;
-    glGenVertexArrays(1, &planeVAO);
-    glGenBuffers(1, &planeVBO);
-    glBindVertexArray(planeVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), planeVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_DOUBLE, GL_FALSE, 8 * sizeof(double), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_DOUBLE, GL_FALSE, 8 * sizeof(double), (void*)(3 * sizeof(double)));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_DOUBLE, GL_FALSE, 8 * sizeof(double), (void*)(6 * sizeof(double)));
-    glBindVertexArray(0);
-
-    // Image VAO/VBO
-    unsigned int VAO, VBO;
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    glBindVertexArray(VAO);
-    glVertexAttribPointer(0, 3, GL_DOUBLE, GL_FALSE, 8 * sizeof(double), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_DOUBLE, GL_FALSE, 8 * sizeof(double), (void*)(3 * sizeof(double)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_DOUBLE, GL_FALSE, 8 * sizeof(double), (void*)(6 * sizeof(double)));
-    glEnableVertexAttribArray(2);
+    // Vertex buffer shared by all tiles
+    TileBatch tileBatch(n);
+
+    // Texture arrays and instance buffer for tile images
+    ImageBatch imageBatch;
+
+    // Connection to the generation server (runserver.py)
+    GenClient genClient("127.0.0.1", 5555);
 
     /*unsigned int diffuseMap = loadTexture("container2.png");
     unsigned int specularMap = loadTexture("container2_specular.png");
     unsigned int floorTexture = loadTexture("wood.png");*/
 
-    unsigned int placeholder = loadTexture("placeholder.png");
+    int placeholder = imageBatch.load("placeholder.png");
 
     // Initialize origin
-    Tile* curTile = new Tile(n, k);
-    Tile::all.push_back(curTile);
+    Tile* curTile = Tile::create(n, k);
 
     curTile->setStart(glm::vec3(0, 0, 0));
     //curTile->Down->texture = loadTexture("gaben.png");
@@ -213,6 +204,7 @@ int main() {
 
         // Process input
         processInput(window);
+        camera.UpdateVelocity(deltaTime);
 
         // Background color
         glClearColor(0.529f, 0.808f, 0.98f, 1.0f);
@@ -236,22 +228,27 @@ int main() {
         //transform = glm::translate(transform, glm::vec3(0.0f, 2.0f, 0.0f));
         //transform = glm::rotate(transform, (float)glfwGetTime(), glm::vec3(0.0f, 0.0f, 1.0f));
         shader.setMat4("transform", transform);
+        shader.setMat3("isometry", glm::mat3(Tile::isometry.m));
+        shader.setInt("colors", 1);
+        shader.setInt("tileSize", n);
 
         // Setup image shader
         imageShader.use();
-        imageShader.setMat4("model", model);
         imageShader.setMat4("view", view);
         imageShader.setMat4("projection", projection);
+        imageShader.setMat3("isometry", glm::mat3(Tile::isometry.m));
+        imageShader.setFloat("scale", rad * 0.3);
+        imageShader.setInt("images", 0);
 
         // Check for tile change
         if (currentFrame - changed > 0.3) {
-            double distCur = curTile->center.y;
+            double distCur = (Tile::isometry * curTile->center).y;
             for (Tile* neighbor : curTile->getNeighbors()) {
-                if (distCur > neighbor->center.y) {
+                if (distCur > (Tile::isometry * neighbor->center).y) {
                     curTile = neighbor;
-                    camera.Position = getXZ(curTile->center);
+                    camera.Position = getXZ(Tile::isometry * curTile->center);
 
-                    glm::vec3 reversed = reverseXZ(curTile->vertices.at(0)->getPos(), camera.Position.x, camera.Position.z);
+                    glm::vec3 reversed = reverseXZ(Tile::isometry * Graph::getPos(curTile->vertices[0]), camera.Position.x, camera.Position.z);
                     double ang = atan2(reversed.z, reversed.x);
                     curTile->angle = ang;
 
@@ -281,65 +278,134 @@ int main() {
             }
 
             Tile::parents.pop();
-            waiting.push(megatile);
+            waiting.push(megatile, currentFrame);
         }
 
-        // Megatiles waiting to be threaded
-        if (!waiting.empty()) {
-            if (numThreads < MAX_THREADS) {
-                numThreads++;
+        // Prefetch along the camera's path. Position moves opposite to the camera, so the camera is heading
+        // along -Velocity; the target is that far along the geodesic from the camera, which stays finite where
+        // translateXZ of a far position would not.
+        if (glm::length(camera.Velocity) > 0.01) {
+            double ahead = glm::length(camera.Velocity) * PREFETCH_HORIZON;
+            glm::dvec3 heading = -glm::normalize(camera.Velocity);
+            glm::dvec3 target(sinh(ahead) * heading.x, cosh(ahead), sinh(ahead) * heading.z);
+            for (Tile* p : GenScheduler::path(curTile, target)) {
+                vector<Tile*> megatile = GenScheduler::claim(p);
+                if (megatile.empty())
+                    continue;
+                for (Tile* t : megatile)
+                    t->texture = placeholder;
+                waiting.push(megatile, currentFrame, true);
+            }
+        }
 
-                // Find nearby tiles that already have images / latent vectors
+        // Count prefetched images as hits once their tile has been visible
+        for (size_t i = 0; i < prefetchedTiles.size();) {
+            if (prefetchedTiles[i]->isVisible()) {
+                statsPrefetchHits++;
+                prefetchedTiles[i] = prefetchedTiles.back();
+                prefetchedTiles.pop_back();
+            } else {
+                i++;
+            }
+        }
+
+        // Requests the client hasn't started on are taken back if their tiles went out of view
+        for (auto it = generating.begin(); it != generating.end();) {
+            if (GenScheduler::stale(it->second) && genClient.cancel(it->first)) {
+                GenScheduler::release(it->second);
+                waiting.dropped++;
+                it = generating.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        // Megatiles waiting to be sent, nearest to the camera and view direction first. The client adapts how
+        // many are out at once; hand it one more only once its queue is empty, so the rest stay here and keep
+        // being re-ranked as the camera moves.
+        waiting.update(camera.Front);
+        if (!waiting.empty()) {
+            if (genClient.stats().queued == 0) {
+                // Find nearby tiles the server already has latent vectors for. Tiles of requests still in flight
+                // are left out: another request may reach the server first, before their latents are stored.
                 vector<Tile*> worldTiles;
                 for (Tile* t : Tile::visible) {
-                    if (t->queueNum != -1)
+                    if (t->hasLatent)
                         worldTiles.push_back(t);
                 }
 
-                vector<Tile*> megatile = waiting.front();
-                allThreads.emplace_back(thread(genImg, megatile, worldTiles, index1));
-                index1 += megatile.size();
-                waiting.pop();
+                Megatile megatile = waiting.pop();
+                GenRequest request = genRequest(megatile.tiles, worldTiles, index1);
+                request.imageSize = imageBatch.size();
+                request.imageLevels = imageBatch.mipLevels();
+                request.saveImages = SAVE_IMAGES;
+                generating[genClient.submit(request)] = megatile;
+                index1 += megatile.tiles.size();
             }
         }
 
         // Link tiles with fully generated images
-        while (!pending.empty()) {
-            // Load texture from generated image for the tile
-            vector<Tile*> megatile = pending.front();
+        genClient.complete([&](const GenResult& result) {
+            // Give the tiles back, so they can be requested again instead of keeping the placeholder
+            if (!result.ok) {
+                cout << "IMAGE GENERATION FAILED: " << result.error << endl;
+                GenScheduler::release(generating[result.id]);
+                generating.erase(result.id);
+                return;
+            }
+
+            // Upload the images straight from the response
+            vector<Tile*>& megatile = generating[result.id].tiles;
+            for (Tile* t : megatile)
+                t->hasLatent = true;
+            if (generating[result.id].prefetched) {
+                statsPrefetched += megatile.size();
+                prefetchedTiles.insert(prefetchedTiles.end(), megatile.begin(), megatile.end());
+            }
+            statsImageWait += glfwGetTime() - generating[result.id].queued;
+            statsImages++;
+            if (!result.pixels.empty()) {
+                for (size_t i = 0; i < result.ids.size(); i++) {
+                    for (auto& t : megatile) {
+                        if (t->queueNum == result.ids[i])
+                            t->texture = imageBatch.add(result.image(i), result.imageSize, result.imageSize, result.imageLevels);
+                    }
+                }
+                generating.erase(result.id);
+                return;
+            }
+
+            // Server without image responses: load texture from generated image for the tile
             for (auto& t : megatile) {
                 string name = "../world_data/images/tile" + to_string(t->queueNum) + ".png";
-                t->texture = loadTexture(name.c_str());
+                int layer = imageBatch.load(name.c_str());
+                if (layer != -1)
+                    t->texture = layer;
             }
-            pending.pop();
-            numThreads--;
-        }
+            generating.erase(result.id);
+        }, UPLOAD_BUDGET);
+
+        // Draw tiles
+        shader.use();
+        tileBatch.update(Tile::visible);
+        tileBatch.draw(1);
 
-        // Draw tiles (and images)
-        for (Tile* t : Tile::visible) {
-            shader.use();
-            setAllVertices(planeVertices, t);
-            shader.setVec4("color", t->color);
-            glBindVertexArray(planeVAO);
-            glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
-            glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), planeVertices, GL_STATIC_DRAW);
-            glDrawArrays(GL_TRIANGLES, 0, 3 * (n - 2));
-
-            if (t->texture != -1)
-            {
-                imageShader.use();
-                model = glm::translate(glm::dmat4(1.0f), getPoincare(t->center));
-                // float imgScale = glm::distance(getPoincare(t->TL), getPoincare(t->BR));
-                float imgScale = rad * 0.3;
-                model = glm::scale(model, glm::vec3(imgScale));
-                model = glm::translate(model, glm::vec3(0, 1, 0));
-                glm::dvec3 target = glm::dvec3(0) - getPoincare(t->center);
-                model = glm::rotate(model, (float) atan2(-target.z, target.x) + glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-                imageShader.setMat4("model", model);
-                glActiveTexture(GL_TEXTURE0);
-                glBindTexture(GL_TEXTURE_2D, t->texture);
-                glBindVertexArray(VAO);
-                glDrawArrays(GL_TRIANGLES, 0, 6);
+        // Draw images
+        imageShader.use();
+        imageBatch.update(Tile::visible);
+        imageBatch.draw(0);
+
+        if (PRINT_STATS) {
+            statsFrames++;
+            if (currentFrame - statsStart >= STATS_INTERVAL) {
+                size_t bytes = tileBatch.bytesUploaded + imageBatch.bytesUploaded;
+                size_t bytesAsDoubles = tileBatch.bytesAsDoubles + imageBatch.bytesAsDoubles;
+                printStats(currentFrame - statsStart, statsFrames, bytes - statsBytes, bytesAsDoubles - statsBytesAsDoubles, Tile::tested - statsTested, genClient.stats());
+                statsStart = currentFrame;
+                statsFrames = 0;
+                statsBytes = bytes;
+                statsBytesAsDoubles = bytesAsDoubles;
+                statsTested = Tile::tested;
             }
         }
 
@@ -350,9 +416,7 @@ int main() {
     // Clean resources allocated for GLFW
     glfwTerminate();
 
-    // Delete generated images after joining all threads
-    for (auto& th : allThreads)
-        th.join();
+    // Delete generated images
     /*for (int i = 0; i < index1; i++)
     {
         string name = to_string(i).append(".png");
@@ -360,34 +424,25 @@ int main() {
     }*/
     //std::remove("image_sampler.pkl");
 
-    // Free tile memory
-    for (Tile* t : Tile::all)
-        delete t;
-
     return 0;
 }
 
-void genImg(vector<Tile*> mega, vector<Tile*> worldTiles, unsigned int ind) {
-    //t->texture = placeholder; // set placeholder earlier
-    string coords = to_string(worldTiles.size());
-
+GenRequest genRequest(const vector<Tile*>& mega, const vector<Tile*>& worldTiles, unsigned int ind) {
+    GenRequest request;
     for (auto& tile : worldTiles) {
         glm::dvec3 c = tile->center;
-        coords += " " + to_string(tile->queueNum) + " " + to_string(c.x) + " " + to_string(c.z);
+        WorldTile w = { tile->queueNum, c.x, c.z };
+        request.world.push_back(w);
     }
 
     for (auto& tile : mega) {
         glm::dvec3 c = tile->center;
-        coords += " " + to_string(c.x) + " " + to_string(c.z);
+        request.coords.push_back(glm::dvec2(c.x, c.z));
+        request.ids.push_back(ind);
         tile->queueNum = ind;
         ind++;
     }
-
-    string input = "python ../sendrequest.py " + coords;
-    //input.append(" " + to_string(ind));
-    system(input.c_str());
-
-    pending.push(mega);
+    return request;
 }
 
 // Callback function for when window is resized
@@ -442,65 +497,30 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
     camera.ProcessMouseScroll(yoffset);
 }
 
-// Load 2D texture from file
-unsigned int loadTexture(char const* path)
-{
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum format = GL_RED;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        // Set the texture wrapping/filtering options (on the currently bound texture object)
-        // Set the texture wrapping parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        // Set texture filtering parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    }
-    else
-        cout << "Texture failed to load at path: " << path << endl;
-
-    stbi_image_free(data);
-    return textureID;
-}
-
 // Print a dvec3
 void printVec(glm::dvec3 v) {
     cout << "(" << v.x << ", " << v.y << ", " << v.z << ")" << endl;
 }
 
-// Set consecutive elements in array to a dvec3
-void setArray(double arr[], glm::dvec3 v, int ind) {
-    arr[ind] = v.x;
-    arr[ind + 1] = v.y;
-    arr[ind + 2] = v.z;
-}
-
-void setAllVertices(double arr[], Tile* tile) {
-    int count = 0;
-    for (int i = 0; i < n - 2; i++) {
-        setArray(arr, getPoincare(tile->vertices.at(0)->getPos()), 8 * count++);
-        setArray(arr, getPoincare(tile->vertices.at(i + 1)->getPos()), 8 * count++);
-        setArray(arr, getPoincare(tile->vertices.at(i + 2)->getPos()), 8 * count++);
-    }
-
-    /*for (int i = 0; i < n - 2; i++) {
-        setArray(arr, getBeltrami(tile->vertices.at(0)->getPos()), 8 * count++);
-        setArray(arr, getBeltrami(tile->vertices.at(i + 1)->getPos()), 8 * count++);
-        setArray(arr, getBeltrami(tile->vertices.at(i + 2)->getPos()), 8 * count++);
-    }*/
+void printStats(double elapsed, unsigned int frames, size_t bytes, size_t bytesAsDoubles, size_t tested, const GenStats& gen) {
+    cout << "frame " << 1000.0 * elapsed / frames << " ms, "
+         << "uploaded " << bytes / frames << " B/frame "
+         << "(" << bytesAsDoubles / frames << " B/frame as doubles), "
+         << Tile::visible.size() << " visible tiles, "
+         << (double)tested / frames << " tested/frame" << endl;
+    double tiles = (double)Tile::arena.size();
+    cout << "graph: " << tiles << " tiles, "
+         << Graph::allocations / tiles << " allocations/tile, "
+         << Graph::slotsCreated / tiles << " new slots/tile, "
+         << Graph::slotsReused / tiles << " reused slots/tile" << endl;
+    cout << "generation: " << waiting.size() << " waiting, "
+         << waiting.dropped << " dropped, "
+         << 100.0 * statsPrefetchHits / std::max<size_t>(statsPrefetched, 1) << "% of " << statsPrefetched << " prefetched images shown, "
+         << 1000.0 * statsImageWait / std::max<size_t>(statsImages, 1) << " ms to image, "
+         << gen.backlog << " to upload, "
+         << gen.queued << " queued, "
+         << gen.inFlight << " in flight (limit " << gen.limit << "), "
+         << 1000.0 * gen.latency << " ms/request, "
+         << gen.completed << " completed, "
+         << gen.failed << " failed" << endl;
 }
\ No newline at end of file
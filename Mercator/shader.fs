@@ -45,6 +45,7 @@ struct SpotLight {
 in vec3 Normal;
 in vec3 FragPos;
 in vec2 TexCoords;
+in vec4 Color;
 
 out vec4 FragColor;
 
@@ -53,7 +54,6 @@ uniform DirLight dirLight;
 uniform SpotLight spotLight;
 uniform Material material;
 uniform vec3 viewPos;
-uniform vec4 color;
 uniform bool blinn;
 
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
@@ -78,7 +78,7 @@ void main()
     //FragColor = texture(material.diffuse, TexCoords);
     */
 
-    FragColor = color;
+    FragColor = Color;
 }
 
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
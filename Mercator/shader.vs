@@ -1,12 +1,16 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
+layout (location = 0) in vec3 aPos; // Point on the hyperboloid
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
+out vec4 Color;
 
+uniform samplerBuffer colors; // Tile colors, one per TileBatch slot
+uniform int tileSize; // Vertices per TileBatch slot
+uniform mat3 isometry; // Camera translation, as a Lorentz transform
 uniform mat4 transform;
 uniform mat4 model;
 uniform mat4 view;
@@ -14,9 +18,14 @@ uniform mat4 projection;
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
+    // Move the point relative to the camera, then take its Poincare projection from (0,-1,0)
+    vec3 hyp = isometry * aPos;
+    vec3 pos = vec3(hyp.x / (hyp.y + 1.0), 0.0, hyp.z / (hyp.y + 1.0));
+
+    FragPos = vec3(model * vec4(pos, 1.0));
     Normal = mat3(transpose(inverse(model))) * aNormal;
     TexCoords = aTexCoords;
+    Color = texelFetch(colors, gl_VertexID / tileSize);
 
     gl_Position = projection * view * transform * vec4(FragPos, 1.0);
 }
\ No newline at end of file
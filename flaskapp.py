@@ -1,16 +1,51 @@
 #!/usr/bin/env python
 
 import threading
+import time
 from flask import Flask, request, make_response, jsonify
-from image_sampler.ImageSampler import ImageSampler
+from image_sampler.InferenceBatcher import InferenceBatcher
+from params import server_configs
 import json
+import genprotocol
+from concurrent.futures import ThreadPoolExecutor
 
 #-----------------------------------------------------------------------
 
 app = Flask(__name__)
-sampler = ImageSampler()
+if server_configs['standin']:
+    from image_sampler.ProceduralSampler import ProceduralSampler
+    sampler = ProceduralSampler()
+else:
+    from image_sampler.ImageSampler import ImageSampler
+    sampler = ImageSampler()
 print("app and sampler created")
 
+# The sampler's GP state and world store are not thread-safe, so only one request at a time may sample latent
+# vectors. Turning the vectors into images happens outside the lock, in forward passes shared by every request
+# waiting at that moment.
+sampler_lock = threading.Lock()
+batcher = InferenceBatcher(sampler.generative_model.generate_multiple,
+                           max_batch_size=server_configs['max_batch_size'],
+                           max_wait=server_configs['max_batch_wait'])
+
+# With batch_stats_interval set, a background thread shows how well requests are sharing forward passes
+def print_batch_stats(interval):
+    passes, vectors = 0, 0
+    while True:
+        time.sleep(interval)
+        new_passes, new_vectors = batcher.passes - passes, batcher.vectors - vectors
+        passes, vectors = passes + new_passes, vectors + new_vectors
+        if new_passes:
+            print("inference: {p} passes, {v} vectors, {f:.1f} per pass (max {m}) in the last {i:g} s".format(
+                p=new_passes, v=new_vectors, f=new_vectors / new_passes, m=batcher.max_batch_size, i=interval))
+
+
+if server_configs['batch_stats_interval'] > 0:
+    threading.Thread(target=print_batch_stats, args=(server_configs['batch_stats_interval'],), daemon=True).start()
+
+# PNGs written off the request path, for tiles whose pixels are returned in the response
+saver = ThreadPoolExecutor(max_workers=1)
+
 #-----------------------------------------------------------------------
 
 @app.route('/get_image', methods=['GET'])
@@ -19,6 +54,50 @@ def get_image():
     data = json.loads(request.args.get('data'))
     world_data = data['world']
     set_of_coords = data['coords']
-    sampler.generate_images_for_megatile(world_data, set_of_coords)
+    with sampler_lock:
+        # /get_image callers leave the numbering of new tiles to the server and count along from 1 on their side,
+        # which only matches in a new world. They send their first megatile with an empty world, so that starts one.
+        if len(world_data) == 0:
+            sampler.new_world()
+        ids, latents = sampler.sample_latents_for_megatile(world_data, set_of_coords)
+    for tile_idx, im in zip(ids, batcher.generate(latents)):
+        sampler.save_image(tile_idx, im)
     
-    return jsonify({'message': 'Complete'})
\ No newline at end of file
+    return jsonify({'message': 'Complete'})
+
+# Binary version of get_image, framed as described in genprotocol.py
+@app.route('/generate', methods=['POST'])
+def generate():
+
+    try:
+        data = genprotocol.decode_request(request.get_data())
+    except genprotocol.ProtocolError as ex:
+        body = genprotocol.encode_response([], status=ex.status, message=str(ex))
+        return make_response(body, 400, {'Content-Type': genprotocol.CONTENT_TYPE})
+
+    ids = [t[0] for t in data['tiles']]
+    coords = [[t[1], t[2]] for t in data['tiles']]
+    size, levels = data['image_size'], data['levels']
+    images = [] if size else None
+
+    def on_image(tile_idx, im):
+        if images is None:
+            sampler.save_image(tile_idx, im)
+            return
+        images.append(genprotocol.image_chain(im, size, levels))
+        if data['save_images']:
+            saver.submit(sampler.save_image, tile_idx, im)
+
+    try:
+        with sampler_lock:
+            ids, latents = sampler.sample_latents_for_megatile([list(t) for t in data['world']], coords,
+                                                               tile_ids=ids, world_latents=data['world_latents'])
+        for tile_idx, im in zip(ids, batcher.generate(latents)):
+            on_image(tile_idx, im)
+    except Exception as ex:
+        body = genprotocol.encode_response([], status=genprotocol.STATUS_FAILED, message=str(ex))
+        return make_response(body, 500, {'Content-Type': genprotocol.CONTENT_TYPE})
+
+    body = genprotocol.encode_response(ids, latents if data['return_latents'] else None,
+                                       images=images, image_size=size, levels=levels)
+    return make_response(body, 200, {'Content-Type': genprotocol.CONTENT_TYPE})
@@ -0,0 +1,203 @@
+#!/usr/bin/env python
+
+'''
+Binary framing for generation requests, shared by flaskapp.py and Mercator/GenProtocol.cpp.
+
+Every message is one frame, all little-endian:
+    header:  magic b'MGEN' | uint16 version | uint16 type | uint32 payload length
+    payload: depends on type, described below
+
+A reader accepts any version up to its own and ignores payload bytes past the fields it knows, so new
+fields can be appended without breaking older peers. Changing the meaning of an existing field needs a
+new version.
+
+GENERATE_REQUEST payload (version 1):
+    uint32 flags (FLAG_WORLD_LATENTS, FLAG_RETURN_LATENTS, FLAG_RETURN_IMAGES, FLAG_SAVE_IMAGES)
+    uint32 world count | uint32 tile count | uint32 latent dim (0 unless FLAG_WORLD_LATENTS)
+    world count x (int32 tile id | float64 x | float64 z)
+    world count x latent dim x float32, if FLAG_WORLD_LATENTS
+    tile count x (int32 tile id | float64 x | float64 z)
+    uint32 image size | uint32 mip levels, used with FLAG_RETURN_IMAGES; size at most MAX_IMAGE_SIZE
+
+GENERATE_RESPONSE payload (version 1):
+    uint32 status (STATUS_*) | uint32 tile count | uint32 latent dim (0 unless latents were asked for)
+    tile count x int32 tile id
+    tile count x latent dim x float32
+    uint32 message length | UTF-8 error message, empty when status is STATUS_OK
+    uint32 image count (tile count, or 0 unless FLAG_RETURN_IMAGES) | uint32 image size | uint32 mip levels
+    image count x mip levels x (RGBA8 pixels, top row first), level l being max(1, size >> l) square
+
+Without FLAG_RETURN_IMAGES the server saves world_data/images/tile{id}.png before it answers, as get_image
+does. With it, the pixels come back in the response and the PNGs are only written, in the background, if
+FLAG_SAVE_IMAGES is also set.
+'''
+
+import struct
+import numpy as np
+
+MAGIC = b'MGEN'
+VERSION = 1
+CONTENT_TYPE = 'application/x-mercator-gen'
+
+GENERATE_REQUEST = 1
+GENERATE_RESPONSE = 2
+
+FLAG_WORLD_LATENTS = 1
+FLAG_RETURN_LATENTS = 2
+FLAG_RETURN_IMAGES = 4
+FLAG_SAVE_IMAGES = 8
+
+# Largest image size a request may ask for, as GEN_MAX_IMAGE_SIZE in GenProtocol.h
+MAX_IMAGE_SIZE = 4096
+
+STATUS_OK = 0
+STATUS_BAD_FRAME = 1
+STATUS_BAD_VERSION = 2
+STATUS_FAILED = 3
+
+_header = struct.Struct('<4sHHI')
+_counts = struct.Struct('<III')
+_tile = np.dtype([('id', '<i4'), ('x', '<f8'), ('z', '<f8')])
+
+
+class ProtocolError(Exception):
+    def __init__(self, status, message):
+        super().__init__(message)
+        self.status = status
+
+
+def read_frame(data, expected_type):
+    """
+    :return: (version, payload) of the frame in data
+    """
+    if len(data) < _header.size:
+        raise ProtocolError(STATUS_BAD_FRAME, 'frame shorter than its header')
+    magic, version, kind, length = _header.unpack_from(data, 0)
+    if magic != MAGIC:
+        raise ProtocolError(STATUS_BAD_FRAME, 'bad magic')
+    if version == 0 or version > VERSION:
+        raise ProtocolError(STATUS_BAD_VERSION, 'unsupported version {v}, up to {m} is supported'.format(v=version, m=VERSION))
+    if kind != expected_type:
+        raise ProtocolError(STATUS_BAD_FRAME, 'unexpected frame type {t}'.format(t=kind))
+    if len(data) < _header.size + length:
+        raise ProtocolError(STATUS_BAD_FRAME, 'payload truncated')
+    return version, memoryview(data)[_header.size:_header.size + length]
+
+
+def write_frame(kind, payload):
+    return _header.pack(MAGIC, VERSION, kind, len(payload)) + payload
+
+
+def decode_request(data):
+    """
+    :return: dict with 'world' (list of (id, x, z)), 'world_latents' (world count x latent dim array or None),
+             'tiles' (list of (id, x, z)) and 'return_latents'
+    """
+    version, payload = read_frame(data, GENERATE_REQUEST)
+    if len(payload) < 4 + _counts.size:
+        raise ProtocolError(STATUS_BAD_FRAME, 'request payload too short')
+    flags, = struct.unpack_from('<I', payload, 0)
+    num_world, num_tiles, latent_dim = _counts.unpack_from(payload, 4)
+    if not flags & FLAG_WORLD_LATENTS:
+        latent_dim = 0
+
+    offset = 4 + _counts.size
+    needed = offset + (num_world + num_tiles) * _tile.itemsize + num_world * latent_dim * 4
+    if len(payload) < needed:
+        raise ProtocolError(STATUS_BAD_FRAME, 'request payload truncated')
+
+    world = np.frombuffer(payload, _tile, num_world, offset)
+    offset += num_world * _tile.itemsize
+    world_latents = None
+    if latent_dim:
+        world_latents = np.frombuffer(payload, '<f4', num_world * latent_dim, offset).reshape(num_world, latent_dim).astype(np.float64)
+        offset += num_world * latent_dim * 4
+    tiles = np.frombuffer(payload, _tile, num_tiles, offset)
+    offset += num_tiles * _tile.itemsize
+
+    image_size, levels = 0, 0
+    if flags & FLAG_RETURN_IMAGES and len(payload) >= offset + 8:
+        image_size, levels = struct.unpack_from('<II', payload, offset)
+        if image_size > MAX_IMAGE_SIZE:
+            raise ProtocolError(STATUS_BAD_FRAME, 'image size {s} is over the limit of {m}'.format(s=image_size, m=MAX_IMAGE_SIZE))
+        levels = max(1, min(levels, image_size.bit_length()))
+
+    return {'world': [(int(t['id']), float(t['x']), float(t['z'])) for t in world],
+            'world_latents': world_latents,
+            'tiles': [(int(t['id']), float(t['x']), float(t['z'])) for t in tiles],
+            'return_latents': bool(flags & FLAG_RETURN_LATENTS),
+            'image_size': image_size,
+            'levels': levels,
+            'save_images': image_size == 0 or bool(flags & FLAG_SAVE_IMAGES)}
+
+
+def image_chain(im, size, levels):
+    """
+    :return: RGBA8 bytes of im resized to size x size, followed by its next levels - 1 mip levels
+    """
+    from PIL import Image
+    level = im.convert('RGBA').resize((size, size), Image.BOX)
+    chain = [level.tobytes()]
+    for _ in range(1, levels):
+        level = level.reduce(2) if level.width > 1 else level
+        chain.append(level.tobytes())
+    return b''.join(chain)
+
+
+def encode_response(tile_ids, latents=None, status=STATUS_OK, message='', images=None, image_size=0, levels=0):
+    """
+    :param latents: tile count x latent dim, or None to leave them out
+    :param images: image_chain() bytes of each tile, or None to leave them out
+    """
+    latent_dim = 0 if latents is None else np.shape(latents)[1]
+    payload = _counts.pack(status, len(tile_ids), latent_dim)
+    payload += np.asarray(tile_ids, dtype='<i4').tobytes()
+    if latent_dim:
+        payload += np.asarray(latents, dtype='<f4').tobytes()
+    text = message.encode('utf-8')
+    payload += struct.pack('<I', len(text)) + text
+    if images is None:
+        payload += struct.pack('<III', 0, 0, 0)
+    else:
+        payload += struct.pack('<III', len(images), image_size, levels) + b''.join(images)
+    return write_frame(GENERATE_RESPONSE, payload)
+
+
+def encode_request(world, tiles, world_latents=None, return_latents=False, image_size=0, levels=1, save_images=False):
+    """
+    Python side of the request encoder, for scripts and tests. world and tiles are lists of (id, x, z).
+    """
+    latent_dim = 0 if world_latents is None else np.shape(world_latents)[1]
+    flags = (FLAG_WORLD_LATENTS if latent_dim else 0) | (FLAG_RETURN_LATENTS if return_latents else 0)
+    flags |= (FLAG_RETURN_IMAGES if image_size else 0) | (FLAG_SAVE_IMAGES if save_images else 0)
+    payload = struct.pack('<I', flags) + _counts.pack(len(world), len(tiles), latent_dim)
+    payload += np.array([tuple(t) for t in world], dtype=_tile).tobytes()
+    if latent_dim:
+        payload += np.asarray(world_latents, dtype='<f4').tobytes()
+    payload += np.array([tuple(t) for t in tiles], dtype=_tile).tobytes()
+    payload += struct.pack('<II', image_size, levels)
+    return write_frame(GENERATE_REQUEST, payload)
+
+
+def decode_response(data):
+    """
+    :return: (status, tile ids, latents or None, message, (image size, levels, pixel bytes) or None)
+    """
+    version, payload = read_frame(data, GENERATE_RESPONSE)
+    status, num_tiles, latent_dim = _counts.unpack_from(payload, 0)
+    offset = _counts.size
+    ids = np.frombuffer(payload, '<i4', num_tiles, offset).tolist()
+    offset += num_tiles * 4
+    latents = None
+    if latent_dim:
+        latents = np.frombuffer(payload, '<f4', num_tiles * latent_dim, offset).reshape(num_tiles, latent_dim)
+        offset += num_tiles * latent_dim * 4
+    length, = struct.unpack_from('<I', payload, offset)
+    message = bytes(payload[offset + 4:offset + 4 + length]).decode('utf-8')
+    offset += 4 + length
+    images = None
+    if len(payload) >= offset + 12:
+        count, size, levels = struct.unpack_from('<III', payload, offset)
+        if count:
+            images = (size, levels, bytes(payload[offset + 12:]))
+    return status, ids, latents, message, images
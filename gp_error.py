@@ -0,0 +1,96 @@
+#!/usr/bin/env python
+
+'''
+How far local GP conditioning (hp['neighbors'] > 0) is from conditioning on the whole world.
+
+Builds a test world from the {4,5} tiling, every tile within --radius of the origin, and draws its latent
+vectors jointly from the GP prior. The tiles in the next ring out play the new tiles, as at the edge of the
+client's view. For each of them, and each K in --neighbors, the posterior given only the K nearest world tiles
+is compared to the posterior given all of them:
+    mean error:  RMS difference of the posterior means over all latent dimensions, in prior standard deviations
+    std ratio:   posterior standard deviation, local over full (local is never smaller)
+    KL:          KL(full || local) per latent dimension, averaged over the test tiles
+
+    python gp_error.py --radius 4 --neighbors 4 8 16 32 64
+'''
+
+import argparse
+import time
+import numpy as np
+from scipy.linalg import solve_triangular
+from params import hp
+from loadgen import Tiling
+from image_sampler.HyperbolicIndex import HyperbolicIndex, pairwise_distances
+from image_sampler.IncrementalGP import IncrementalGP, cholesky
+
+
+def covariance(coords1, coords2):
+    # The kernel of ImageSampler.compute_covariance_matrix, sigma^2 exp(-d / alpha)
+    return hp['sigma'] ** 2 * np.exp(-pairwise_distances(coords1, coords2) / hp['alpha'])
+
+
+def posterior(coords, latents, coord):
+    '''
+    :return: (mean, variance) at coord given tiles at coords with the given latent vectors
+    '''
+    K = covariance(coords, coords) + 1e-8 * np.eye(len(coords))
+    L = cholesky(K)
+    a = solve_triangular(L, covariance(coords, [coord])[:, 0], lower=True)
+    mean = a @ solve_triangular(L, latents, lower=True)
+    return mean, max(covariance([coord], [coord])[0, 0] - a @ a, 1e-12)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compare local and full GP conditioning on a test world')
+    parser.add_argument('--radius', type=float, default=4.0, help='world tiles are those within this of the origin')
+    parser.add_argument('--neighbors', type=int, nargs='+', default=[4, 8, 16, 32, 64])
+    parser.add_argument('--dim', type=int, default=28, help='latent dimensions')
+    parser.add_argument('--tests', type=int, default=50, help='new tiles to sample, at most')
+    parser.add_argument('--seed', type=int, default=0)
+    args = parser.parse_args()
+    rng = np.random.default_rng(args.seed)
+
+    tiling = Tiling()
+    tiles = tiling.within(0, np.array([0.0, 1.0, 0.0]), args.radius + 1.2)
+    dist = {t: np.arccosh(max(tiling.centers[t][1], 1.0)) for t in tiles}
+    world = [t for t in tiles if dist[t] <= args.radius]
+    ring = [t for t in tiles if dist[t] > args.radius]
+    tests = [ring[i] for i in rng.permutation(len(ring))[:args.tests]]
+    coords = [[tiling.centers[t][0], tiling.centers[t][2]] for t in world]
+
+    K = covariance(coords, coords) + 1e-8 * np.eye(len(coords))
+    latents = cholesky(K) @ rng.standard_normal((len(coords), args.dim))
+    print('{w} world tiles within {r}, {t} new tiles around them, {d} latent dimensions'.format(
+        w=len(world), r=args.radius, t=len(tests), d=args.dim))
+
+    full = IncrementalGP(covariance, args.dim)
+    full.add(list(range(len(world))), coords, latents)
+    start = time.perf_counter()
+    truth = []
+    for t in tests:
+        c = [tiling.centers[t][0], tiling.centers[t][2]]
+        a = solve_triangular(full.L, covariance(full.coords, [c])[:, 0], lower=True)
+        truth.append((a @ full.B, covariance([c], [c])[0, 0] - a @ a))
+    full_time = (time.perf_counter() - start) / len(tests)
+    print('full GP: {ms:.2f} ms per tile, given the factor of all {m} tiles'.format(ms=full_time * 1000, m=len(world)))
+
+    index = HyperbolicIndex(list(range(len(world))), coords)
+    prior_std = hp['sigma']
+    print('{a:>5} {b:>12} {c:>10} {d:>10} {e:>12}'.format(a='K', b='mean error', c='std ratio', d='KL', e='ms per tile'))
+    for k in args.neighbors:
+        errors, ratios, kls = [], [], []
+        start = time.perf_counter()
+        for t, (mean, var) in zip(tests, truth):
+            c = [tiling.centers[t][0], tiling.centers[t][2]]
+            near = [i for i, _ in index.nearest(c, k)]
+            local_mean, local_var = posterior([coords[i] for i in near], latents[near], c)
+            errors.append(np.mean((local_mean - mean) ** 2))
+            ratios.append(np.sqrt(local_var / var))
+            kls.append(0.5 * np.mean(np.log(local_var / var) + (var + (mean - local_mean) ** 2) / local_var - 1))
+        elapsed = (time.perf_counter() - start) / len(tests)
+        print('{a:>5} {b:>12.4f} {c:>10.4f} {d:>10.4f} {e:>12.2f}'.format(
+            a=k, b=np.sqrt(np.mean(errors)) / prior_std, c=np.mean(ratios), d=np.mean(kls), e=elapsed * 1000))
+
+
+if __name__ == '__main__':
+    main()
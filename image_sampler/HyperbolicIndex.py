@@ -0,0 +1,108 @@
+import heapq
+import numpy as np
+
+
+def lift(coords):
+    """
+    :param coords: n (x, z) pairs
+    :return: n x 3 array of the points on the hyperboloid, as (x, y, z) with y = sqrt(1 + x^2 + z^2)
+    """
+    coords = np.asarray(coords, dtype=np.float64).reshape(-1, 2)
+    x, z = coords[:, 0], coords[:, 1]
+    return np.stack([x, np.sqrt(1 + x ** 2 + z ** 2), z], axis=1)
+
+
+def distances(points, p):
+    """
+    :return: hyperbolic distance from each of points to p, all lifted
+    """
+    mink_dot = points[:, 1] * p[1] - points[:, 0] * p[0] - points[:, 2] * p[2]
+    return np.arccosh(np.maximum(mink_dot, 1.0))
+
+
+def pairwise_distances(coords1, coords2):
+    """
+    :return: a x b matrix of hyperbolic distances between two lists of (x, z), with every point lifted once
+    """
+    p1, p2 = lift(coords1), lift(coords2)
+    diff = p1[:, np.newaxis, :] - p2[np.newaxis, :, :]
+    # |p - q|^2 under the Minkowski metric is 2 cosh d - 2 = 4 sinh^2(d / 2). Taken from the differences rather
+    # than from arccosh of the product, it keeps the distance between near points, and gives 0 for equal ones.
+    chord = diff[..., 0] ** 2 + diff[..., 2] ** 2 - diff[..., 1] ** 2
+    return 2 * np.arcsinh(0.5 * np.sqrt(np.maximum(chord, 0.0)))
+
+
+class HyperbolicIndex:
+    """
+    Nearest-neighbor index over tiles on the hyperboloid: a vantage-point tree under the hyperbolic distance.
+
+    Each node splits its points into those within the median distance of a vantage point and those beyond it.
+    The triangle inequality lets a query skip whichever side can't hold anything nearer than the k-th best found
+    so far, so a query costs O(log n) distance evaluations for points spread over the plane, rather than O(n).
+    Points added after the tree is built are kept in a short list that every query scans, and folded into the
+    tree once that list grows past the square root of the tree's size.
+    """
+    LEAF_SIZE = 8
+
+    def __init__(self, ids, coords):
+        self.ids = list(ids)
+        self.points = lift(coords) if len(self.ids) else np.zeros((0, 3))
+        self.extra = []  # Indices into ids/points not yet in the tree
+        self.root = self.build(np.arange(len(self.ids)))
+
+    def __len__(self):
+        return len(self.ids)
+
+    def build(self, indices):
+        if len(indices) <= self.LEAF_SIZE:
+            return ('leaf', indices)
+        vantage, rest = indices[0], indices[1:]
+        d = distances(self.points[rest], self.points[vantage])
+        radius = np.median(d)
+        inside = d <= radius
+        return ('node', vantage, radius, self.build(rest[inside]), self.build(rest[~inside]))
+
+    def add(self, tile_id, coord):
+        self.ids.append(tile_id)
+        self.points = np.vstack([self.points, lift([coord])])
+        self.extra.append(len(self.ids) - 1)
+        if len(self.extra) ** 2 > len(self.ids):
+            self.root = self.build(np.arange(len(self.ids)))
+            self.extra = []
+
+    def nearest(self, coord, k):
+        """
+        :return: (id, distance) of the k tiles nearest coord, nearest first
+        """
+        p = lift([coord])[0]
+        best = []  # Max-heap of (-distance, index), at most k long
+
+        def offer(indices):
+            for i, di in zip(indices, distances(self.points[indices], p)):
+                if len(best) < k:
+                    heapq.heappush(best, (-di, i))
+                elif di < -best[0][0]:
+                    heapq.heapreplace(best, (-di, i))
+
+        def tau():
+            return -best[0][0] if len(best) == k else np.inf
+
+        def search(node):
+            if node[0] == 'leaf':
+                if len(node[1]):
+                    offer(node[1])
+                return
+            _, vantage, radius, inside, outside = node
+            dv = distances(self.points[[vantage]], p)[0]
+            offer([vantage])
+            # Search the side p falls in first; the other side only if the k-th best could still be there
+            first, second = (inside, outside) if dv <= radius else (outside, inside)
+            search(first)
+            if abs(dv - radius) <= tau():
+                search(second)
+
+        if k > 0 and len(self.ids):
+            search(self.root)
+            if self.extra:
+                offer(self.extra)
+        return [(self.ids[i], -nd) for nd, i in sorted(best, reverse=True)]
@@ -2,218 +2,163 @@ import math
 from typing import List, Tuple
 from params import hp, path_configs
 from os.path import join
-import pandas as pd
 from PIL import Image
 from model_data.hyperbolic_generative_model import HyperbolicGenerativeModel
 from model_data.GANzoo import PoincareGANzoo
 from model_data.JTVAE import PoincareJTVAE
 import numpy as np
-import os
 import random
-import copy
-from scipy.spatial.distance import pdist, squareform
+from image_sampler.IncrementalGP import IncrementalGP
+from image_sampler.HyperbolicIndex import HyperbolicIndex, pairwise_distances
+from image_sampler.WorldStore import WorldStore
 
 models = {'poincare': PoincareJTVAE}
 
 class ImageSampler:
     def __init__(self, starting_tiles=None):
-        self.path_to_world_data = join(path_configs['world_data_dir'], 'world_data.csv')
+        self.path_to_world_data = join(path_configs['world_data_dir'], 'world.bin')
         self.sigma = hp['sigma']
         self.alpha = hp['alpha']
         self.lscale = hp['lscale']
+        self.neighbors = hp['neighbors']
         assert issubclass(models[hp['model_family']], HyperbolicGenerativeModel)
         assert self.sigma > 0
         assert self.alpha > 0
         self.model_family = models[hp['model_family']]
         self.generative_model = self.model_family()
 
-        if starting_tiles is not None:
-            starting_records = [{'tile_index': 0,
-                                 'tile_x': tile[0],
-                                 'tile_y': tile[1],
-                                 'latent_vector': self.get_random_coords(self.model_family.latent_dim).tolist()}
-                                for tile in starting_tiles]
-        else:
-            starting_records = [{'tile_index': 0,
-                                 'tile_x': 0,
-                                 'tile_y': 0,
-                                 'latent_vector': self.get_random_coords(self.model_family.latent_dim).tolist()}]
-        data_df = pd.DataFrame(starting_records)
-        data_df.to_csv(self.path_to_world_data)
-
-    def generate_images_for_megatile(self, world_data: List[Tuple[int, float, float]], tile_coords: List[Tuple[float, float]]):
-        ### 1. read in old data with schema (tile_index, tile_x, tile_y, latent_vector)
-        if os.path.isfile(self.path_to_world_data):
-            data_df = pd.read_csv(self.path_to_world_data)
-        else:
-            data_df = pd.DataFrame(columns=['tile_index', 'tile_x', 'tile_y', 'latent_vector'])
+        # Posterior over the tiles the last request conditioned on, updated rather than rebuilt per request
+        self.gp = IncrementalGP(self.compute_covariance_matrix, self.model_family.latent_dim)
 
+        # Tiles generated so far, kept across restarts. A new world starts from tile 0 at the origin.
+        self.starting_tiles = starting_tiles if starting_tiles is not None else [(0, 0)]
+        self.world = WorldStore(self.path_to_world_data, self.model_family.latent_dim)
+        if len(self.world) == 0:
+            self.add_starting_tiles()
 
-        
-        # ### 2. sample new latent space vectors
-        # latent_space_vectors = self.sample_latent_vector(data_df=data_df, world_data=world_data, list_of_test_coords=tile_coords)
-
-        # new_tile_records = []
-        # ### 3. write images to folder
-        # for i, v in enumerate(latent_space_vectors):
-        #     tile_idx = i + len(data_df)
-        #     im = self.generative_model.generate_image_from_latent_vector(v)
-        #     im.save(join(path_configs['world_data_dir'], 'images', 'tile{tile_idx}.png'.format(tile_idx=tile_idx)), "PNG")
-        #     if not isinstance(v, list):
-        #         v = v.tolist()
-        #     new_tile_records.append({'tile_index': tile_idx,
-        #                              'tile_x': tile_coords[i][0],
-        #                              'tile_y': tile_coords[i][1],
-        #                              'latent_vector': v})
-
-        # ### 4. write new data with schema (tile_index, tile_x, tile_y, latent_vector)
-        # new_df = pd.DataFrame(new_tile_records)
-        # data_df = pd.concat([data_df, new_df])
-        # data_df.to_csv(self.path_to_world_data)
-        
-        
-        wd = world_data
+    def new_world(self):
+        """
+        Forget every generated tile and start again from the starting tiles.
+        """
+        self.world.clear()
+        self.gp = IncrementalGP(self.compute_covariance_matrix, self.model_family.latent_dim)
+        self.add_starting_tiles()
+
+    def add_starting_tiles(self):
+        self.world.append([0] * len(self.starting_tiles), self.starting_tiles,
+                          [self.get_random_coords(self.model_family.latent_dim) for _ in self.starting_tiles])
+
+    def generate_images_for_megatile(self, world_data: List[Tuple[int, float, float]], tile_coords: List[Tuple[float, float]],
+                                     tile_ids: List[int] = None, world_latents=None, on_image=None):
+        """
+        :param tile_ids: index to save each new tile under. Defaults to numbering on from the tiles already in the world store.
+        :param world_latents: latent vector of each tile in world_data, if the caller has them. Otherwise they are
+                              looked up in the world store.
+        :param on_image: called with (tile index, PIL image) for each new tile. Defaults to save_image.
+        :return: the latent vectors of the new tiles, in order
+        """
+        if on_image is None:
+            on_image = self.save_image
+
+        tile_ids, latents = self.sample_latents_for_megatile(world_data, tile_coords, tile_ids, world_latents)
+        ims = self.generative_model.generate_multiple(np.array(latents)) if latents else []
+        for tile_idx, im in zip(tile_ids, ims):
+            on_image(tile_idx, im)
+        return latents
+
+    def sample_latents_for_megatile(self, world_data: List[Tuple[int, float, float]], tile_coords: List[Tuple[float, float]],
+                                    tile_ids: List[int] = None, world_latents=None):
+        """
+        First half of generate_images_for_megatile: samples the latent vectors of the new tiles and records them in
+        the world store, without running the generative model. The caller turns the vectors into images, so that
+        vectors from several megatiles can share one forward pass.
+
+        :return: (index of each new tile, latent vector of each new tile)
+        """
 
         ########## Initialization
         if len(world_data) == 0:
             #tile_coords.insert(0, [0,0])
 
-            # same as hyperboloid_distance, but takes in two vectors
-            def dist2(a, b):
-                x1, z1 = a
-                x2, z2 = b
-                y1 = math.sqrt(1 + x1**2 + z1**2)
-                y2 = math.sqrt(1 + x2**2 + z2**2)
-                minkDot = y1 * y2 - x1 * x2 - z1 * z2
-                if minkDot < 1:
-                    return 0
-                return math.acosh(minkDot)
-
-            dists = squareform(pdist(tile_coords, dist2))
+            dists = pairwise_distances(tile_coords, tile_coords)
             K = np.exp(-0.5*dists / self.lscale**2) + 1e-6*np.eye(len(tile_coords))
             cK = np.linalg.cholesky(K)
             noise = cK @ np.random.randn(len(tile_coords), self.model_family.latent_dim)
-            ims = self.generative_model.generate_multiple(noise)
-            for i, im in enumerate(ims):
-                tile_idx = i + 1
-                im.save(join(path_configs['world_data_dir'], 'images', 'tile{tile_idx}.png'.format(tile_idx=tile_idx)), "PNG")
-                new_tile_record = {'tile_index': tile_idx, 'tile_x': tile_coords[i][0], 'tile_y': tile_coords[i][1], 'latent_vector': [noise[i].tolist()]}
-                new_df = pd.DataFrame(new_tile_record)
-                data_df = pd.concat([data_df, new_df])
-            data_df.to_csv(self.path_to_world_data)
-
-            return
-        ##########
+            indices = [tile_ids[i] if tile_ids is not None else i + 1 for i in range(len(tile_coords))]
+            self.world.append(indices, tile_coords, noise)
 
+            # An empty world is a client starting a new session, which numbers its tiles from 1 again. The
+            # posterior still holds the last session's tiles under those ids, so start it over.
+            self.gp = IncrementalGP(self.compute_covariance_matrix, self.model_family.latent_dim)
 
+            return indices, noise.tolist()
+        ##########
 
-        start_idx = len(data_df)
-        
-        for i in range(len(tile_coords)):
 
-            tile_idx = i + start_idx
 
-            v = self.sample_latent_vector(data_df=data_df, world_data=wd, list_of_test_coords=[tile_coords[i]])
-            wd.append((tile_idx, tile_coords[i][0], tile_coords[i][1]))
+        start_idx = self.world.next_id()
+        latents_given = world_latents is not None and len(world_latents) == len(world_data)
 
-            im = self.generative_model.generate_image_from_latent_vector(v)
-            im.save(join(path_configs['world_data_dir'], 'images', 'tile{tile_idx}.png'.format(tile_idx=tile_idx)), "PNG")
-            if not isinstance(v, list):
-                v = v.tolist()
-            new_tile_record = {'tile_index': tile_idx,
-                               'tile_x': tile_coords[i][0],
-                               'tile_y': tile_coords[i][1],
-                               'latent_vector': v}
-            new_df = pd.DataFrame(new_tile_record)
-            data_df = pd.concat([data_df, new_df])
+        def latent_of(i):
+            if latents_given:
+                return world_latents[i]
+            return self.world.latent(world_data[i][0])
 
-        data_df.to_csv(self.path_to_world_data)
-        
+        if self.neighbors > 0:
+            # Local conditioning: each tile is sampled given only the nearest tiles generated before it
+            index = HyperbolicIndex([tile[0] for tile in world_data], [[tile[1], tile[2]] for tile in world_data])
+            local_coords = {tile[0]: [tile[1], tile[2]] for tile in world_data}
+            local_latents = {}
+            positions = {tile[0]: i for i, tile in enumerate(world_data)}
 
-    # this implements the GP logic
-    def sample_latent_vector(self, data_df, world_data, list_of_test_coords):
-        """
-        :param data_df:
-        :param list_of_test_coords:
-
-        Let the number of training points (X: coords from data_df) be m.
-        Let the number of test points (X_*: coords from list_of_test_coords) be n.
-        Let the latent space dimensionality be d.
-        We want to do posterior inference f(X_*) | f(X), X, X_*.
-
-        1. compute the training covariance matrix K of size mxm.
-        2. compute the train-test covariance matrix K_* of size mxn.
-        3. compute the test covariance matrix K_** of size nxn.
-        4. compute the posterior covariance SIGMA = K_** - K_*^T K^(-1) K_*.  This is the same for each of the d GPs.
+            def local_latent_of(tile_idx):
+                if tile_idx not in local_latents:
+                    local_latents[tile_idx] = latent_of(positions[tile_idx])
+                return local_latents[tile_idx]
+        else:
+            # Condition on this request's world: tiles that left it are downdated out of the posterior, tiles
+            # that joined it are added, and the rest keep their rows of the factor
+            self.gp.sync(world_data, latent_of, latents_given)
 
-        5. for each latent space dim:
-            - compute the posterior mean MU = K_*^T K f
-            - sample from the multivariate normal distribution N(MU, SIGMA).  Will be a vector of size n.
+        indices = []
+        latents = []
+        
+        for i in range(len(tile_coords)):
 
-        6. Collect all d vectors of size n into an nxd matrix.  Transpose and re-slice into n vectors of size d.
+            tile_idx = tile_ids[i] if tile_ids is not None else i + start_idx
+            indices.append(tile_idx)
+
+            # Each new tile joins the conditioning set before the next one is sampled
+            if self.neighbors > 0:
+                v = self.sample_local_latent_vector(index, tile_coords[i], local_coords, local_latent_of)
+                index.add(tile_idx, tile_coords[i])
+                local_coords[tile_idx] = list(tile_coords[i])
+                local_latents[tile_idx] = v
+            else:
+                v = self.gp.sample(tile_coords[i])
+                self.gp.add([tile_idx], [tile_coords[i]], [v])
+            latents.append(v.tolist())
+
+        self.world.append(indices, tile_coords, latents)
+        return indices, latents
+        
 
-        :return: a list of n vectors of size d representing the sampled latent space vectors.
+    def sample_local_latent_vector(self, index, coord, coords_of, latent_of):
         """
-        if len(data_df) == 0:
-            raise ValueError("World initialized incorrectly")
-        else:
-            if isinstance(data_df.iloc[0]['latent_vector'], str):
-                data_df['latent_vector'] = data_df['latent_vector'].apply(lambda x: eval(x))
-
-        #list_of_train_coords = data_df.apply(lambda row: (row['tile_x'], row['tile_y']), axis=1).tolist()
+        Vecchia-style conditioning: sample at coord given only the self.neighbors tiles of index nearest to it.
+        The kernel decays with distance, so far tiles add little, and the cost per tile stays O(log m + K^3)
+        however large the world grows.
 
+        :param coords_of: (x, z) by tile id
+        :param latent_of: latent_of(tile id) returns the latent vector of a tile in index
+        """
+        ids = [tile_idx for tile_idx, _ in index.nearest(coord, self.neighbors)]
+        local = IncrementalGP(self.compute_covariance_matrix, self.model_family.latent_dim)
+        local.add(ids, [coords_of[tile_idx] for tile_idx in ids], [latent_of(tile_idx) for tile_idx in ids])
+        return local.sample(coord)
 
-        if len(world_data) == 0:
-            world_data = copy.copy(world_data)
-            world_data.append([0, 0, 0])
-            '''
-            ret = []
-            for i in range(len(list_of_test_coords)):
-                ret.append(np.random.normal(0,0.01,self.model_family.latent_dim))
-            return ret
-            '''
-
-        list_of_train_coords = []
-        list_of_indices = []
-        for tile in world_data:
-            list_of_train_coords.append([tile[1], tile[2]])
-            list_of_indices.append(tile[0])
-        
-        culled_data = data_df.loc[data_df['tile_index'].isin(list_of_indices)]
-
-        m = len(list_of_train_coords)
-        n = len(list_of_test_coords)
-        d = self.model_family.latent_dim
-
-        # 1. compute the training covariance matrix K of size mxm.
-        train_cov = self.compute_covariance_matrix(list_of_train_coords, list_of_train_coords)
-        train_cov += np.eye(train_cov.shape[0])*1e-8  # Prevent singular matrices
-        # 2. compute the train-test covariance matrix K_* of size mxn.
-        train_test_cov = self.compute_covariance_matrix(list_of_train_coords, list_of_test_coords)
-        # 3. compute the test covariance matrix K_** of size nxn.
-        test_cov = self.compute_covariance_matrix(list_of_test_coords, list_of_test_coords)
-
-        # 4. compute the posterior covariance SIGMA = K_** - K_*^T K^(-1) K_*. This is the same for each of the d GPs.
-        posterior_cov = test_cov - train_test_cov.T @ np.linalg.inv(train_cov) @ train_test_cov
-
-        # 5. for each latent space dim:
-        latent_slices = []
-        for dim in range(d):
-            # compute the posterior mean MU = K_*^T K^(-1) f
-            f = culled_data['latent_vector'].apply(lambda x: x[dim])
-            posterior_mean = train_test_cov.T @ np.linalg.inv(train_cov) @ f
-            # sample from the multivariate normal distribution N(MU, SIGMA).  Will be a vector of size n.
-            test_sample_along_dim = np.random.multivariate_normal(mean=posterior_mean, cov=posterior_cov)
-            latent_slices.append(test_sample_along_dim)
-
-        # 6. Collect all d vectors of size n into an nxd matrix. Transpose and re-slice into n vectors of size d.
-        #latent_matrix = np.concatenate(latent_slices).reshape((n, d))
-        latent_matrix = np.array(latent_slices).T
-
-        #latent_matrix = latent_matrix / np.sqrt(np.sum(latent_matrix**2, axis=1, keepdims=True))
-        #latent_matrix = np.random.randn(*latent_matrix.shape)
-        
-        return latent_matrix.tolist()
+    def save_image(self, tile_idx, im):
+        im.save(join(path_configs['world_data_dir'], 'images', 'tile{tile_idx}.png'.format(tile_idx=tile_idx)), "PNG")
 
     # closed form of distance formula on Poincare disk
     def geodesic_distance(self, x1, y1, x2, y2):
@@ -253,11 +198,11 @@ class ImageSampler:
         :param coords2: list of b coords
         :return: return a covariance matrix of size axb
         """
-        cov = np.zeros((len(coords1), len(coords2)))
-        for row, (x1, y1) in enumerate(coords1):
-            for col, (x2, y2) in enumerate(coords2):
-                cov[row, col] = self.k(x1, y1, x2, y2)
-        return cov
+        # Same as self.k on every pair: each point is lifted to the hyperboloid once, and the distances come from
+        # one matrix product
+        if len(coords1) == 0 or len(coords2) == 0:
+            return np.zeros((len(coords1), len(coords2)))
+        return (self.sigma ** 2) * np.exp(-1 * pairwise_distances(coords1, coords2) / self.alpha)
 
     def get_random_coords(self, d):
         """
@@ -0,0 +1,148 @@
+import numpy as np
+from scipy.linalg import solve_triangular
+
+
+def cholesky(cov):
+    """
+    Lower Cholesky factor of a covariance matrix that may be singular up to rounding, as a posterior
+    covariance is when a test point sits on a training point. Adds jitter to the diagonal until it factors.
+    """
+    jitter = 0
+    scale = max(np.mean(np.diag(cov)), 1e-12) if len(cov) else 1
+    while True:
+        try:
+            return np.linalg.cholesky(cov + jitter * np.eye(len(cov)))
+        except np.linalg.LinAlgError:
+            jitter = 1e-10 * scale if jitter == 0 else jitter * 10
+            if jitter > scale:
+                raise
+
+
+def cholesky_update(L, x):
+    """
+    Turns L, the lower Cholesky factor of A, into that of A + x x^T, in place.
+    """
+    x = np.array(x, dtype=np.float64)
+    for k in range(len(x)):
+        r = np.hypot(L[k, k], x[k])
+        c = r / L[k, k]
+        s = x[k] / L[k, k]
+        L[k, k] = r
+        L[k + 1:, k] = (L[k + 1:, k] + s * x[k + 1:]) / c
+        x[k + 1:] = c * x[k + 1:] - s * L[k + 1:, k]
+
+
+class IncrementalGP:
+    """
+    GP posterior over a conditioning set of tiles, kept between requests.
+
+    Holds the Cholesky factor L of the training covariance K, the training latent vectors F (one row per tile)
+    and B = L^(-1) F, which is all sampling needs: for a test point with covariances k_* to the set,
+    a = L^(-1) k_* gives the posterior mean a^T B and variance k(x, x) - a^T a. Adding k tiles extends L by k
+    rows in O(m^2 k); removing one is a rank-one update of the rows below it. Nothing is refactored from
+    scratch, so the cost per tile depends on the size of the set, not on how many tiles the world has seen.
+
+    Only distances enter the kernel, so L stays valid when the client sends the same tiles in a new frame;
+    sync() just takes the new coordinates.
+    """
+
+    def __init__(self, covariance, latent_dim, noise=1e-8):
+        """
+        :param covariance: covariance(coords1, coords2) returns the kernel matrix between two lists of (x, z)
+        :param noise: added to the diagonal of K, to keep it away from singular
+        """
+        self.covariance = covariance
+        self.latent_dim = latent_dim
+        self.noise = noise
+        self.ids = []
+        self.coords = []
+        self.index = {}
+        self.L = np.zeros((0, 0))
+        self.F = np.zeros((0, latent_dim))
+        self.B = np.zeros((0, latent_dim))
+
+    def __len__(self):
+        return len(self.ids)
+
+    def sync(self, world, latent_of, latents_given=False):
+        """
+        Make the conditioning set exactly the tiles in world, with their coordinates as given.
+
+        :param world: list of (tile id, x, z)
+        :param latent_of: latent_of(i) returns the latent vector of world[i]; only called for tiles not in the set
+        :param latents_given: latent_of comes from the client, so a tile whose vector differs from the one held
+                              (the client started a new world with the same ids) is replaced
+        """
+        wanted = {tile[0]: i for i, tile in enumerate(world)}
+        stale = [tile_id for tile_id in self.ids if tile_id not in wanted]
+        if latents_given:
+            stale += [tile_id for tile_id in self.ids
+                      if tile_id in wanted and not np.allclose(self.F[self.index[tile_id]], latent_of(wanted[tile_id]))]
+        self.remove(stale)
+
+        for tile_id, i in wanted.items():
+            if tile_id in self.index:
+                self.coords[self.index[tile_id]] = [world[i][1], world[i][2]]
+        new = [i for tile_id, i in wanted.items() if tile_id not in self.index]
+        self.add([world[i][0] for i in new], [[world[i][1], world[i][2]] for i in new],
+                 np.array([latent_of(i) for i in new], dtype=np.float64).reshape(len(new), self.latent_dim))
+
+    def add(self, ids, coords, latents):
+        """
+        Extend the set by k tiles:  [L 0; C^T D] with C = L^(-1) K_sn and D D^T = K_nn - C^T C.
+        """
+        if len(ids) == 0:
+            return
+        self.remove([tile_id for tile_id in ids if tile_id in self.index])
+        latents = np.asarray(latents, dtype=np.float64).reshape(len(ids), self.latent_dim)
+
+        k_nn = self.covariance(coords, coords) + self.noise * np.eye(len(ids))
+        m = len(self.ids)
+        if m > 0:
+            C = solve_triangular(self.L, self.covariance(self.coords, coords), lower=True)
+            D = cholesky(k_nn - C.T @ C)
+            B_new = solve_triangular(D, latents - C.T @ self.B, lower=True)
+            self.L = np.block([[self.L, np.zeros((m, len(ids)))], [C.T, D]])
+        else:
+            D = cholesky(k_nn)
+            B_new = solve_triangular(D, latents, lower=True)
+            self.L = D
+        self.F = np.vstack([self.F, latents])
+        self.B = np.vstack([self.B, B_new])
+
+        for tile_id, c in zip(ids, coords):
+            self.index[tile_id] = len(self.ids)
+            self.ids.append(tile_id)
+            self.coords.append(list(c))
+
+    def remove(self, ids):
+        """
+        Drop tiles from the set. Removing row i leaves L31 in place and turns L33 into the factor of
+        L33 L33^T + l32 l32^T, a rank-one update; rows of B from i on are solved again against the new L33.
+        """
+        for i in sorted((self.index[tile_id] for tile_id in set(ids)), reverse=True):
+            l32 = self.L[i + 1:, i].copy()
+            L = np.delete(np.delete(self.L, i, axis=0), i, axis=1)
+            if len(l32):
+                cholesky_update(L[i:, i:], l32)
+            self.L = L
+            self.F = np.delete(self.F, i, axis=0)
+            self.B = np.delete(self.B, i, axis=0)
+            if len(l32):
+                self.B[i:] = solve_triangular(self.L[i:, i:], self.F[i:] - self.L[i:, :i] @ self.B[:i], lower=True)
+
+            del self.ids[i]
+            del self.coords[i]
+        self.index = {tile_id: i for i, tile_id in enumerate(self.ids)}
+
+    def sample(self, coord):
+        """
+        :return: a latent vector drawn from the posterior at coord, given every tile in the set
+        """
+        prior = self.covariance([coord], [coord])[0, 0]
+        if len(self.ids) == 0:
+            return np.sqrt(prior) * np.random.randn(self.latent_dim)
+        a = solve_triangular(self.L, self.covariance(self.coords, [coord])[:, 0], lower=True)
+        mean = a @ self.B
+        variance = max(prior - a @ a, 0.0)
+        return mean + np.sqrt(variance) * np.random.randn(self.latent_dim)
@@ -0,0 +1,99 @@
+import queue
+import threading
+import time
+import numpy as np
+
+
+class _Job:
+    def __init__(self, vectors):
+        self.vectors = vectors
+        self.images = None
+        self.error = None
+        self.done = threading.Event()
+
+
+class InferenceBatcher:
+    """
+    Runs the generative model on latent vectors gathered from every request in flight.
+
+    Each caller hands over the vectors of its megatile and blocks. A single worker thread waits for the first
+    job, keeps collecting jobs until the next one would take it past max_batch_size vectors or max_wait seconds
+    have passed, runs them through generate_multiple in one pass, and hands each job back its own images. A job
+    larger than max_batch_size on its own is split into several passes. A request that arrives alone waits at
+    most max_wait before its forward pass starts.
+    """
+
+    def __init__(self, generate_multiple, max_batch_size=16, max_wait=0.01):
+        """
+        :param generate_multiple: takes an n x d array of latent vectors and returns n images
+        """
+        assert max_batch_size > 0
+        assert max_wait >= 0
+        self.generate_multiple = generate_multiple
+        self.max_batch_size = max_batch_size
+        self.max_wait = max_wait
+        self.jobs = queue.Queue()
+
+        # Forward passes run and vectors they covered, for flaskapp's batch stats line
+        self.passes = 0
+        self.vectors = 0
+
+        self.worker = threading.Thread(target=self._run, name='InferenceBatcher', daemon=True)
+        self.worker.start()
+
+    def generate(self, vectors):
+        """
+        :param vectors: n latent vectors
+        :return: the n images, in order. Raises whatever the model raised if its batch failed.
+        """
+        if len(vectors) == 0:
+            return []
+        job = _Job(np.asarray(vectors, dtype=np.float64).reshape(len(vectors), -1))
+        self.jobs.put(job)
+        job.done.wait()
+        if job.error is not None:
+            raise job.error
+        return job.images
+
+    def _run(self):
+        held = None  # A job that didn't fit in the last batch, which starts the next one
+        while True:
+            batch = [held if held is not None else self.jobs.get()]
+            held = None
+            count = len(batch[0].vectors)
+            deadline = time.monotonic() + self.max_wait
+            while count < self.max_batch_size:
+                remaining = deadline - time.monotonic()
+                if remaining <= 0:
+                    break
+                try:
+                    job = self.jobs.get(timeout=remaining)
+                except queue.Empty:
+                    break
+                if count + len(job.vectors) > self.max_batch_size:
+                    held = job
+                    break
+                batch.append(job)
+                count += len(job.vectors)
+            self._process(batch)
+
+    def _process(self, batch):
+        try:
+            vectors = np.concatenate([job.vectors for job in batch])
+            images = []
+            for start in range(0, len(vectors), self.max_batch_size):
+                images.extend(self.generate_multiple(vectors[start:start + self.max_batch_size]))
+                self.passes += 1
+            self.vectors += len(vectors)
+        except Exception as ex:
+            for job in batch:
+                job.error = ex
+                job.done.set()
+            return
+
+        # Scatter the images back in the order the vectors were gathered
+        offset = 0
+        for job in batch:
+            job.images = images[offset:offset + len(job.vectors)]
+            offset += len(job.vectors)
+            job.done.set()
@@ -0,0 +1,83 @@
+import random
+import struct
+import time
+import zlib
+from os.path import join
+from typing import List, Tuple
+import numpy as np
+from PIL import Image
+from params import path_configs, server_configs
+
+
+class ProceduralModel:
+    """
+    Stand-in for the generative model: draws a pattern from the first few entries of each latent vector, and
+    sleeps as long as server_configs says a forward pass should take.
+    """
+    image_size = 256
+
+    def __init__(self, latency, latency_per_image, jitter):
+        self.latency = latency
+        self.latency_per_image = latency_per_image
+        self.jitter = jitter
+
+    def generate_image_from_latent_vector(self, v) -> Image:
+        return self.generate_multiple(np.reshape(v, (1, -1)))[0]
+
+    def generate_multiple(self, v):
+        time.sleep(self.latency + self.latency_per_image * len(v) + random.uniform(0, self.jitter))
+        return [self.draw(np.asarray(v1)) for v1 in v]
+
+    def draw(self, v):
+        u = np.linspace(0, 1, self.image_size)
+        xx, yy = np.meshgrid(u, u)
+        # One plane wave per channel, with frequencies and phase taken from the vector
+        channels = [0.5 + 0.5 * np.sin(2 * np.pi * (v[3 * c] * xx + v[3 * c + 1] * yy) + v[3 * c + 2]) for c in range(3)]
+        return Image.fromarray(np.uint8(np.stack(channels, axis=-1) * 255))
+
+
+class ProceduralSampler:
+    """
+    Drop-in replacement for ImageSampler that needs no model weights, no torch and no world store. Every
+    tile's latent vector is a hash of its coordinates, so the same tile always gets the same image, whatever
+    the world around it. Used by runserver.py --standin to benchmark the client pipeline on any machine.
+    """
+    latent_dim = 9
+
+    def __init__(self):
+        self.generative_model = ProceduralModel(server_configs['standin_latency'],
+                                                server_configs['standin_latency_per_image'],
+                                                server_configs['standin_jitter'])
+        self.next_index = 1
+
+    def new_world(self):
+        self.next_index = 1
+
+    def generate_images_for_megatile(self, world_data: List[Tuple[int, float, float]], tile_coords: List[Tuple[float, float]],
+                                     tile_ids: List[int] = None, world_latents=None, on_image=None):
+        if on_image is None:
+            on_image = self.save_image
+
+        tile_ids, latents = self.sample_latents_for_megatile(world_data, tile_coords, tile_ids, world_latents)
+        ims = self.generative_model.generate_multiple(np.array(latents)) if latents else []
+        for tile_idx, im in zip(tile_ids, ims):
+            on_image(tile_idx, im)
+        return latents
+
+    def sample_latents_for_megatile(self, world_data: List[Tuple[int, float, float]], tile_coords: List[Tuple[float, float]],
+                                    tile_ids: List[int] = None, world_latents=None):
+        if tile_ids is None:
+            tile_ids = list(range(self.next_index, self.next_index + len(tile_coords)))
+        self.next_index = max([self.next_index] + [i + 1 for i in tile_ids])
+        return tile_ids, [self.latent_vector(x, z).tolist() for x, z in tile_coords]
+
+    def latent_vector(self, x, z):
+        # Rounded so that the same tile reached along different paths, with different rounding error, matches
+        seed = zlib.crc32(struct.pack('<dd', round(x, 6), round(z, 6)))
+        rng = np.random.default_rng(seed)
+        return np.concatenate([rng.uniform(0.5, 4, 2), rng.uniform(0, 2 * np.pi, 1),
+                               rng.uniform(0.5, 4, 2), rng.uniform(0, 2 * np.pi, 1),
+                               rng.uniform(0.5, 4, 2), rng.uniform(0, 2 * np.pi, 1)])
+
+    def save_image(self, tile_idx, im):
+        im.save(join(path_configs['world_data_dir'], 'images', 'tile{tile_idx}.png'.format(tile_idx=tile_idx)), "PNG")
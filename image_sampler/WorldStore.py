@@ -0,0 +1,129 @@
+import os
+import struct
+import numpy as np
+
+MAGIC = b'MWLD'
+VERSION = 1
+_header = struct.Struct('<4sHHI')  # magic | uint16 version | uint16 reserved | uint32 latent dim
+
+
+class WorldStore:
+    """
+    Every generated tile's coordinates and latent vector, in an append-only binary file.
+
+    After a 12-byte header the file is a run of fixed-size little-endian records:
+        int32 tile id | float64 x | float64 z | latent dim x float32
+    A tile written again gets a new record, and the newest record of each id is the live one. Reads go through
+    a memory map and an index from tile id to record, so a request only touches the records it asks for and
+    appending costs only the new records. When superseded records outnumber the live ones the file is
+    rewritten with just the live records, which keeps it proportional to the world rather than its history.
+
+    Not safe for concurrent use; flaskapp calls it under sampler_lock.
+    """
+    COMPACT_MIN_DEAD = 1024
+
+    def __init__(self, path, latent_dim):
+        self.path = path
+        self.latent_dim = latent_dim
+        self.dtype = np.dtype([('id', '<i4'), ('x', '<f8'), ('z', '<f8'), ('latent', '<f4', (latent_dim,))])
+        self.index = {}
+        self.records = 0
+        self.map = None
+
+        if os.path.isfile(path) and os.path.getsize(path) >= _header.size:
+            with open(path, 'rb') as f:
+                magic, version, _, dim = _header.unpack(f.read(_header.size))
+            if magic != MAGIC or version != VERSION or dim != latent_dim:
+                raise ValueError('{p} is not a version {v} world store with {d} latent dimensions'.format(
+                    p=path, v=VERSION, d=latent_dim))
+            # A record cut short by a crash mid-append is dropped
+            self.records = (os.path.getsize(path) - _header.size) // self.dtype.itemsize
+            os.truncate(path, _header.size + self.records * self.dtype.itemsize)
+            self.remap()
+            self.index = {int(tile_id): i for i, tile_id in enumerate(self.map['id'])}
+        else:
+            with open(path, 'wb') as f:
+                f.write(_header.pack(MAGIC, VERSION, 0, latent_dim))
+
+    def __len__(self):
+        return len(self.index)
+
+    def __contains__(self, tile_id):
+        return tile_id in self.index
+
+    def ids(self):
+        return self.index.keys()
+
+    def next_id(self):
+        return max(self.index) + 1 if self.index else 0
+
+    def remap(self):
+        self.map = None
+        if self.records:
+            self.map = np.memmap(self.path, dtype=self.dtype, mode='r', offset=_header.size, shape=(self.records,))
+
+    def record(self, tile_id):
+        i = self.index.get(tile_id)
+        if i is None:
+            raise KeyError('No latent vector for tile {t}'.format(t=tile_id))
+        if self.map is None or i >= len(self.map):
+            self.remap()
+        return self.map[i]
+
+    def latent(self, tile_id):
+        return np.array(self.record(tile_id)['latent'], dtype=np.float64)
+
+    def coords(self, tile_id):
+        r = self.record(tile_id)
+        return float(r['x']), float(r['z'])
+
+    def append(self, tile_ids, coords, latents):
+        """
+        :param coords: (x, z) of each tile
+        :param latents: latent vector of each tile
+        """
+        if len(tile_ids) == 0:
+            return
+        rows = np.zeros(len(tile_ids), dtype=self.dtype)
+        rows['id'] = tile_ids
+        coords = np.asarray(coords, dtype=np.float64).reshape(len(tile_ids), 2)
+        rows['x'], rows['z'] = coords[:, 0], coords[:, 1]
+        rows['latent'] = np.asarray(latents, dtype=np.float64).reshape(len(tile_ids), self.latent_dim)
+        with open(self.path, 'ab') as f:
+            f.write(rows.tobytes())
+        for tile_id in tile_ids:
+            self.index[int(tile_id)] = self.records
+            self.records += 1
+
+        dead = self.records - len(self.index)
+        if dead >= self.COMPACT_MIN_DEAD and dead > len(self.index):
+            self.compact()
+
+    def clear(self):
+        """
+        Drop every record, leaving an empty store.
+        """
+        self.map = None
+        with open(self.path, 'wb') as f:
+            f.write(_header.pack(MAGIC, VERSION, 0, self.latent_dim))
+        self.index = {}
+        self.records = 0
+
+    def compact(self):
+        """
+        Rewrite the file with only the live records, then swap it in.
+        """
+        self.remap()
+        live = sorted(self.index.values())
+        rows = np.array(self.map[live]) if live else np.zeros(0, dtype=self.dtype)
+        temp = self.path + '.tmp'
+        with open(temp, 'wb') as f:
+            f.write(_header.pack(MAGIC, VERSION, 0, self.latent_dim))
+            f.write(rows.tobytes())
+            f.flush()
+            os.fsync(f.fileno())
+        self.map = None  # Windows won't replace a file that is still mapped
+        os.replace(temp, self.path)
+        self.records = len(rows)
+        self.index = {int(tile_id): i for i, tile_id in enumerate(rows['id'])}
+        self.remap()
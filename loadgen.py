@@ -0,0 +1,277 @@
+#!/usr/bin/env python
+
+'''
+Load generator for the generation server. Moves a camera over the {4,5} tiling in real time, asks for every
+tile that comes within view the way Mercator does, and reports throughput and time-to-image percentiles.
+
+Meant to run against runserver.py --standin, which needs no model weights:
+    python runserver.py 5555 --standin
+    python loadgen.py --port 5555 --duration 30 --concurrency 4
+
+The camera either replays a path file (one "x,z" hyperboloid position per line, sampled at --rate) or wanders
+on its own from --seed, turning back towards the origin past --wander so coordinates stay well conditioned.
+Time-to-image is measured from the frame a tile first came within --view to the response carrying its image.
+
+--get-image needs --concurrency 1. That route numbers tiles in the order requests reach the server, which only
+matches the order they were queued here when one is sent at a time.
+'''
+
+import argparse
+import http.client
+import json
+import math
+import queue
+import threading
+import time
+from urllib.parse import quote
+import numpy as np
+import genprotocol
+
+# {4,5} tiling: squares, five at each vertex. Neighboring centers are twice the inradius apart.
+P, Q = 4, 5
+NEIGHBOR_DISTANCE = 2 * math.acosh(math.cos(math.pi / Q) / math.sin(math.pi / P))
+
+ORIGIN = np.array([0.0, 1.0, 0.0])  # (x, y, z) with y the height, as in the client
+
+
+def translate(d):
+    c, s = math.cosh(d), math.sinh(d)
+    return np.array([[c, s, 0], [s, c, 0], [0, 0, 1]])
+
+
+def rotate(a):
+    c, s = math.cos(a), math.sin(a)
+    return np.array([[c, 0, -s], [0, 1, 0], [s, 0, c]])
+
+
+def distance(a, b):
+    return math.acosh(max(1.0, a[1] * b[1] - a[0] * b[0] - a[2] * b[2]))
+
+
+class Tiling:
+    '''
+    Tile centers, found on demand by stepping across the edges of tiles already known
+    '''
+    def __init__(self):
+        self.frames = [np.eye(3)]
+        self.centers = [ORIGIN.copy()]
+        self.neighbors = [None]
+        self.index = {self.key(ORIGIN): 0}
+        self.steps = [rotate(k * math.pi / 2) @ translate(NEIGHBOR_DISTANCE) for k in range(P)]
+
+    @staticmethod
+    def key(p):
+        return (round(p[0], 5), round(p[2], 5))
+
+    def neighbors_of(self, t):
+        if self.neighbors[t] is None:
+            self.neighbors[t] = []
+            for step in self.steps:
+                frame = self.frames[t] @ step
+                center = frame @ ORIGIN
+                n = self.index.get(self.key(center))
+                if n is None:
+                    n = len(self.centers)
+                    self.index[self.key(center)] = n
+                    self.frames.append(frame)
+                    self.centers.append(center)
+                    self.neighbors.append(None)
+                self.neighbors[t].append(n)
+        return self.neighbors[t]
+
+    def nearest(self, start, point):
+        '''
+        :return: the tile whose center is nearest point, walking downhill from the tile start
+        '''
+        t = start
+        while True:
+            n = min(self.neighbors_of(t), key=lambda n: distance(self.centers[n], point))
+            if distance(self.centers[n], point) >= distance(self.centers[t], point):
+                return t
+            t = n
+
+    def within(self, start, point, radius):
+        '''
+        :return: tiles whose centers are within radius of point, found from the tile start near it
+        '''
+        found, frontier, seen = [], [start], {start}
+        while frontier:
+            t = frontier.pop()
+            if distance(self.centers[t], point) > radius + NEIGHBOR_DISTANCE:
+                continue
+            if distance(self.centers[t], point) <= radius:
+                found.append(t)
+            for n in self.neighbors_of(t):
+                if n not in seen:
+                    seen.add(n)
+                    frontier.append(n)
+        return found
+
+
+def wander(duration, rate, speed, wander_radius, seed):
+    '''
+    :return: camera positions, one per frame
+    '''
+    rng = np.random.default_rng(seed)
+    frame, positions = np.eye(3), []
+    for _ in range(int(duration * rate)):
+        position = frame @ ORIGIN
+        positions.append(position)
+        turn = rng.normal(0, 0.5) / rate
+        if distance(position, ORIGIN) > wander_radius:
+            # Turn towards the origin, measured in the camera's own frame
+            back = np.linalg.solve(frame, ORIGIN)
+            error = math.atan2(back[2], back[0])
+            turn = max(-2.0 / rate, min(2.0 / rate, error))
+        frame = frame @ rotate(turn) @ translate(speed / rate)
+    return positions
+
+
+def read_path(filename):
+    positions = []
+    for line in open(filename):
+        if line.strip():
+            x, z = (float(v) for v in line.split(',')[:2])
+            positions.append(np.array([x, math.sqrt(1 + x * x + z * z), z]))
+    return positions
+
+
+class Stats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.latencies = []
+        self.waits = []
+        self.tiles = 0
+        self.failed = 0
+
+
+def sender(args, tiling, jobs, generated, stats):
+    connection = http.client.HTTPConnection(args.host, args.port, timeout=60)
+    while True:
+        job = jobs.get()
+        if job is None:
+            break
+        megatile, needed, ids = job
+        with stats.lock:
+            world = sorted(generated.items(), key=lambda item: distance(tiling.centers[item[0]], tiling.centers[megatile[0]]))
+            world = [(index, tiling.centers[t][0], tiling.centers[t][2]) for t, index in world[:args.world]]
+        tiles = [(index, tiling.centers[t][0], tiling.centers[t][2]) for t, index in zip(megatile, ids)]
+
+        start = time.monotonic()
+        try:
+            if args.get_image:
+                data = json.dumps({'world': [list(w) for w in world], 'coords': [[x, z] for _, x, z in tiles]})
+                connection.request('GET', '/get_image?data=' + quote(data))
+                response = connection.getresponse()
+                response.read()
+                ok = response.status == 200
+            else:
+                body = genprotocol.encode_request(world, tiles, image_size=args.size, levels=args.levels)
+                connection.request('POST', '/generate', body, {'Content-Type': genprotocol.CONTENT_TYPE})
+                response = connection.getresponse()
+                status = genprotocol.decode_response(response.read())[0]
+                ok = response.status == 200 and status == genprotocol.STATUS_OK
+        except Exception:
+            connection.close()
+            ok = False
+        done = time.monotonic()
+
+        with stats.lock:
+            if not ok:
+                stats.failed += 1
+                continue
+            stats.latencies.append(done - start)
+            stats.waits.extend(done - t for t in needed)
+            stats.tiles += len(megatile)
+            for t, index in zip(megatile, ids):
+                generated[t] = index
+    connection.close()
+
+
+def megatiles(tiling, new_tiles, camera):
+    '''
+    Group tiles into megatiles of a tile and its new neighbors, nearest to the camera first
+    '''
+    new_tiles = sorted(new_tiles, key=lambda t: distance(tiling.centers[t], camera))
+    unclaimed = set(new_tiles)
+    groups = []
+    for t in new_tiles:
+        if t not in unclaimed:
+            continue
+        group = [t] + [n for n in tiling.neighbors_of(t) if n in unclaimed and n != t]
+        unclaimed.difference_update(group)
+        groups.append(group)
+    return groups
+
+
+def percentiles(values):
+    if not values:
+        return 'none'
+    ms = np.asarray(values) * 1000
+    return 'p50 {a:.0f} ms, p90 {b:.0f} ms, p99 {c:.0f} ms, max {d:.0f} ms'.format(
+        a=np.percentile(ms, 50), b=np.percentile(ms, 90), c=np.percentile(ms, 99), d=ms.max())
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Replay a camera path against the generation server')
+    parser.add_argument('--host', default='127.0.0.1')
+    parser.add_argument('--port', type=int, default=5555)
+    parser.add_argument('--path', help='file of x,z camera positions, one per frame')
+    parser.add_argument('--duration', type=float, default=20, help='seconds of wandering, without --path')
+    parser.add_argument('--rate', type=float, default=30, help='frames per second')
+    parser.add_argument('--speed', type=float, default=0.5, help='camera speed while wandering, per second')
+    parser.add_argument('--wander', type=float, default=4.0, help='distance from the origin to turn back at')
+    parser.add_argument('--seed', type=int, default=0)
+    parser.add_argument('--view', type=float, default=2 * math.atanh(0.75), help='view radius, as in Tile::setStart')
+    parser.add_argument('--concurrency', type=int, default=4, help='requests in flight at once')
+    parser.add_argument('--world', type=int, default=20, help='generated tiles sent to condition on')
+    parser.add_argument('--size', type=int, default=64, help='image size to ask for')
+    parser.add_argument('--levels', type=int, default=1, help='mip levels to ask for')
+    parser.add_argument('--get-image', action='store_true', help='use GET /get_image instead of POST /generate; needs --concurrency 1')
+    args = parser.parse_args()
+    if args.get_image and args.concurrency != 1:
+        parser.error('--get-image numbers tiles on the server in arrival order, so it needs --concurrency 1')
+
+    positions = read_path(args.path) if args.path else wander(args.duration, args.rate, args.speed, args.wander, args.seed)
+    tiling = Tiling()
+    jobs = queue.Queue()
+    generated = {}
+    stats = Stats()
+    threads = [threading.Thread(target=sender, args=(args, tiling, jobs, generated, stats))
+               for _ in range(args.concurrency)]
+
+    # Lay out everything the path will see before the clock starts, so the timed walk measures the server
+    current = 0
+    for position in positions:
+        current = tiling.nearest(current, position)
+        tiling.within(current, position, args.view)
+    for thread in threads:
+        thread.start()
+
+    requested, next_index, current, start = set(), 1, 0, time.monotonic()
+    for frame, position in enumerate(positions):
+        now = time.monotonic()
+        current = tiling.nearest(current, position)
+        new_tiles = [t for t in tiling.within(current, position, args.view) if t not in requested]
+        requested.update(new_tiles)
+        for group in megatiles(tiling, new_tiles, position):
+            jobs.put((group, [now] * len(group), list(range(next_index, next_index + len(group)))))
+            next_index += len(group)
+        time.sleep(max(0.0, start + (frame + 1) / args.rate - time.monotonic()))
+    path_time = time.monotonic() - start
+
+    for _ in threads:
+        jobs.put(None)
+    for thread in threads:
+        thread.join()
+    wall = time.monotonic() - start
+
+    print('{f} frames over {p:.1f} s, {t} tiles in {r} requests, {x} failed'.format(
+        f=len(positions), p=path_time, t=stats.tiles, r=len(stats.latencies), x=stats.failed))
+    print('throughput: {a:.1f} tiles/s over {w:.1f} s'.format(a=stats.tiles / wall, w=wall))
+    print('request latency: ' + percentiles(stats.latencies))
+    print('time to image:   ' + percentiles(stats.waits))
+
+
+if __name__ == '__main__':
+    main()
@@ -2,6 +2,7 @@
 
 import torch
 from model_data.hyperbolic_generative_model import HyperbolicGenerativeModel
+from params import machine_configs, move
 from PIL import Image
 import numpy as np
 
@@ -11,7 +12,7 @@ class PoincareGANzoo(HyperbolicGenerativeModel):
 
     def __init__(self):
         # PGAN models: ['celebAHQ-256', 'celebAHQ-512', 'DTD', 'celeba']
-        use_gpu = True if torch.cuda.is_available() else False
+        use_gpu = machine_configs['device'] != 'cpu'
         self.model = torch.hub.load('facebookresearch/pytorch_GAN_zoo:hub',
                                     'PGAN', model_name='celebAHQ-512',
                                      pretrained=True, useGPU=use_gpu)
@@ -29,17 +30,12 @@ class PoincareGANzoo(HyperbolicGenerativeModel):
         # https://github.com/facebookresearch/pytorch_GAN_zoo/blob/main/models/base_GAN.py#L328
         # v = torch.randn(1, latent_dim).to('cuda')
 
-        v = torch.tensor(v, dtype=torch.float).to('cuda').unsqueeze(dim=0)
-
-        with torch.no_grad():
-            outputs = self.model.test(v, toCPU=True)
-
-        images = self.convert_to_images(outputs)
-        return images[0]
+        return self.generate_multiple(np.reshape(v, (1, -1)))[0]
 
     def generate_multiple(self, v) -> Image:
 
-        v = torch.tensor(v, dtype=torch.float).to('cuda')
+        # One forward pass for the whole batch; on CPU it runs on machine_configs['inference_threads'] threads
+        v = move(torch.tensor(np.asarray(v), dtype=torch.float))
 
         with torch.no_grad():
             generated_images = self.model.test(v, toCPU=True)
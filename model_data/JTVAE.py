@@ -13,7 +13,9 @@ im.save("testing.png")
 '''
 
 import torch
+import multiprocessing
 from model_data.hyperbolic_generative_model import HyperbolicGenerativeModel
+from params import machine_configs, move
 from PIL import Image
 import numpy as np
 
@@ -23,12 +25,27 @@ from rdkit.Chem.Draw import MolToImage
 import sys
 sys.path.insert(0,'model_data/fast_jtnn')
 from model_data.fast_jtnn import *
+import nnutils
 
 import rdkit
 
 lg = rdkit.RDLogger.logger() 
 lg.setLevel(rdkit.RDLogger.CRITICAL)
 
+# The model in each decode worker process, inherited from the parent when the pool forks
+_decoder = None
+
+def _init_decoder(model):
+    global _decoder
+    _decoder = model
+    # The workers already run in parallel; more threads each would only compete for the same cores
+    torch.set_num_threads(1)
+
+def _decode(v):
+    with torch.no_grad():
+        smiles = _decoder.sample_from_v(torch.tensor(v, dtype=torch.float).unsqueeze(dim=0))
+    return MolToImage(Chem.MolFromSmiles(smiles))
+
 class PoincareJTVAE(HyperbolicGenerativeModel):
 
     latent_dim = 28
@@ -45,13 +62,25 @@ class PoincareJTVAE(HyperbolicGenerativeModel):
         model = 'model_data/model.iter-400000'
 
         self.model = JTNNVAE(vocab, hidden_size, latent_size, depthT, depthG)
-        self.model.load_state_dict(torch.load(model))
-        self.model = self.model.cuda()
+        nnutils.set_device(machine_configs['device'])
+        self.model.load_state_dict(torch.load(model, map_location=nnutils.device))
+        self.model = move(self.model)
+
+        # Decoding is a tree search with one small forward pass per step, so it can't be batched. On CPU, spread
+        # the molecules over a pool of processes instead. The pool is forked here, before the server starts any
+        # threads, and the workers share the weights rather than loading their own copy. CUDA doesn't survive a
+        # fork, so on GPU the molecules are decoded one at a time.
+        self.pool = None
+        workers = machine_configs['decode_workers']
+        if machine_configs['device'] == 'cpu' and workers > 1 and 'fork' in multiprocessing.get_all_start_methods():
+            self.model.share_memory()
+            self.pool = multiprocessing.get_context('fork').Pool(workers, initializer=_init_decoder,
+                                                                 initargs=(self.model,))
 
 
     def generate_image_from_latent_vector(self, v) -> Image:
 
-        v = torch.tensor(v, dtype=torch.float).to('cuda')
+        v = move(torch.tensor(v, dtype=torch.float))
 
         with torch.no_grad():
             output = self.model.sample_from_v(v)
@@ -60,7 +89,10 @@ class PoincareJTVAE(HyperbolicGenerativeModel):
 
     def generate_multiple(self, v) -> Image:
 
-        v = torch.tensor(v, dtype=torch.float).to('cuda')
+        if self.pool is not None and len(v) > 1:
+            return self.pool.map(_decode, [np.asarray(v1) for v1 in v])
+
+        v = move(torch.tensor(np.asarray(v), dtype=torch.float))
 
         outputs = []
         with torch.no_grad():
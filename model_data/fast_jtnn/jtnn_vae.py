@@ -66,8 +66,8 @@ class JTNNVAE(nn.Module):
         return z_vecs, kl_loss
 
     def sample_prior(self, prob_decode=False):
-        z_tree = torch.randn(1, self.latent_size).cuda()
-        z_mol = torch.randn(1, self.latent_size).cuda()
+        z_tree = create_var(torch.randn(1, self.latent_size))
+        z_mol = create_var(torch.randn(1, self.latent_size))
         return self.decode(z_tree, z_mol, prob_decode)
 
     def sample_from_v(self, v):
@@ -177,7 +177,7 @@ class JTNNVAE(nn.Module):
             return None, cur_mol
 
         cand_smiles,cand_amap = zip(*cands)
-        aroma_score = torch.Tensor(aroma_score).cuda()
+        aroma_score = create_var(torch.Tensor(aroma_score))
         cands = [(smiles, all_nodes, cur_node) for smiles in cand_smiles]
 
         if len(cands) > 1:
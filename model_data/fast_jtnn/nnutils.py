@@ -3,11 +3,18 @@ import torch.nn as nn
 import torch.nn.functional as F
 from torch.autograd import Variable
 
+# Where create_var puts tensors. The model's parameters must be on the same device.
+device = torch.device('cuda' if torch.cuda.is_available() else 'cpu')
+
+def set_device(d):
+    global device
+    device = torch.device(d)
+
 def create_var(tensor, requires_grad=None):
     if requires_grad is None:
-        return Variable(tensor).cuda()
+        return Variable(tensor).to(device)
     else:
-        return Variable(tensor, requires_grad=requires_grad).cuda()
+        return Variable(tensor, requires_grad=requires_grad).to(device)
 
 def index_select_ND(source, dim, index):
     index_size = index.size()
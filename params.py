@@ -1,8 +1,12 @@
 import os
 from os.path import join, dirname
-import torch
 import math
 
+try:
+    import torch
+except ImportError:  # Only the procedural stand-in server (runserver.py --standin) can run without it
+    torch = None
+
 ### PATH CONFIGS ###
 
 _root_directory = dirname(__file__)
@@ -24,22 +28,52 @@ safe_mkdir(join(path_configs['world_data_dir'], 'images'))
 
 ### HARDWARE CONFIGS ###
 
-if torch.cuda.is_available():
+# Set MERCATOR_DEVICE=cpu to run the models on CPU even where CUDA is available
+if torch is not None and torch.cuda.is_available() and os.environ.get('MERCATOR_DEVICE', 'cuda') != 'cpu':
     torch.cuda.set_device(0)
     _device = 0
 else:
     _device = 'cpu'
 
-# _device = 'cpu'  # TODO: debug CUDA
-machine_configs = {'device': _device}
+# inference_threads: threads torch uses inside one operator, on CPU. decode_workers: processes decoding JT-VAE
+# molecules in parallel on CPU, each with one thread; 0 or 1 decodes on the calling thread.
+machine_configs = {'device': _device,
+                   'inference_threads': int(os.environ.get('MERCATOR_THREADS', os.cpu_count() or 1)),
+                   'decode_workers': int(os.environ.get('MERCATOR_DECODE_WORKERS', os.cpu_count() or 1))
+                   }
+
+if _device == 'cpu' and torch is not None:
+    torch.set_num_threads(machine_configs['inference_threads'])
+
+### SERVER CONFIGS ###
+
+# Latent vectors from concurrent requests are gathered into one forward pass of the generative model: at most
+# max_batch_size vectors per pass, and the first request waits at most max_batch_wait seconds for others to join.
+#
+# standin replaces the model with image_sampler/ProceduralSampler.py, for benchmarking without model weights.
+# Each of its forward passes takes standin_latency + standin_latency_per_image * batch size seconds, plus up
+# to standin_jitter seconds more at random.
+#
+# batch_stats_interval: print how many forward passes ran and how full they were every this many seconds; 0 is off.
+server_configs = {'max_batch_size': 16,
+                  'max_batch_wait': 0.01,
+                  'batch_stats_interval': float(os.environ.get('MERCATOR_BATCH_STATS', 0)),
+                  'standin': os.environ.get('MERCATOR_STANDIN', '0') != '0',
+                  'standin_latency': float(os.environ.get('MERCATOR_STANDIN_LATENCY', 0.05)),
+                  'standin_latency_per_image': float(os.environ.get('MERCATOR_STANDIN_LATENCY_PER_IMAGE', 0.01)),
+                  'standin_jitter': float(os.environ.get('MERCATOR_STANDIN_JITTER', 0.02))
+                  }
 
 
 def move(x):
     return x.to(_device)
 
 # hyperparameters
+# neighbors: condition each new tile on only this many nearest generated tiles, instead of the whole world the
+# client sent; 0 conditions on all of them. gp_error.py reports how far the local posterior is from the full one.
 hp = {'sigma': 1.0,
       'alpha': 3.2,
       'lscale': 1.6,
-      'model_family': 'poincare'
+      'model_family': 'poincare',
+      'neighbors': 0
       }
@@ -1,22 +1,36 @@
 #!/usr/bin/env python
 
+import os
 from sys import argv, exit, stderr
-from flaskapp import app
 
 def main():
 
-    if len(argv) != 2:
-        print('Usage: ' + argv[0] + ' port', file=stderr)
+    # --standin serves procedural images instead of running the model; see server_configs in params.py
+    standin = '--standin' in argv[1:]
+    args = [a for a in argv[1:] if a != '--standin']
+    if len(args) != 1:
+        print('Usage: ' + argv[0] + ' port [--standin]', file=stderr)
         exit(1)
 
     try:
-        port = int(argv[1])
+        port = int(args[0])
     except Exception:
         print('Port must be an integer.', file=stderr)
         exit(1)
 
+    if standin:
+        os.environ['MERCATOR_STANDIN'] = '1'
+    from flaskapp import app
+
     try:
-        app.run(host='0.0.0.0', port=port, debug=True)
+        # The client keeps one connection open across requests. Flask's development server closes the
+        # connection after every response, so use waitress when it is installed.
+        try:
+            from waitress import serve
+        except ImportError:
+            app.run(host='0.0.0.0', port=port, debug=True)
+        else:
+            serve(app, host='0.0.0.0', port=port, threads=8)
     except Exception as ex:
         print(ex, file=stderr)
         exit(1)
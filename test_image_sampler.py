@@ -0,0 +1,74 @@
+#!/usr/bin/env python
+
+'''
+Checks of ImageSampler's state across requests, run without model weights:
+
+    python test_image_sampler.py
+
+The model modules need torch, so they are replaced by a stub with a small latent dimension. The world store is
+written to a temporary directory.
+'''
+
+import sys
+import types
+import tempfile
+import unittest
+import numpy as np
+
+
+class StubModel:
+    latent_dim = 8
+
+    def __init__(self, *args, **kwargs):
+        pass
+
+
+for _name in ['model_data.hyperbolic_generative_model', 'model_data.GANzoo', 'model_data.JTVAE']:
+    sys.modules[_name] = types.ModuleType(_name)
+sys.modules['model_data.hyperbolic_generative_model'].HyperbolicGenerativeModel = object
+sys.modules['model_data.GANzoo'].PoincareGANzoo = StubModel
+sys.modules['model_data.JTVAE'].PoincareJTVAE = StubModel
+
+import params
+from image_sampler.ImageSampler import ImageSampler
+
+
+class SessionTest(unittest.TestCase):
+    def setUp(self):
+        self.directory = tempfile.TemporaryDirectory()
+        self.world_data_dir = params.path_configs['world_data_dir']
+        params.path_configs['world_data_dir'] = self.directory.name
+        self.neighbors = params.hp['neighbors']
+        params.hp['neighbors'] = 0
+        self.sampler = ImageSampler()
+
+    def tearDown(self):
+        params.path_configs['world_data_dir'] = self.world_data_dir
+        params.hp['neighbors'] = self.neighbors
+        self.directory.cleanup()
+
+    def session(self, first, second):
+        '''
+        A client session as the renderer runs it: the first megatile is sent with an empty world, and the next
+        one conditions on the origin and the first megatile, by id only.
+        '''
+        first_ids = list(range(1, len(first) + 1))
+        self.sampler.sample_latents_for_megatile([], first, tile_ids=first_ids)
+        world = [(0, 0.0, 0.0)] + [(tile_id, x, z) for tile_id, (x, z) in zip(first_ids, first)]
+        second_ids = list(range(len(first) + 1, len(first) + len(second) + 1))
+        return self.sampler.sample_latents_for_megatile(world, second, tile_ids=second_ids)
+
+    def test_second_session_conditions_on_its_own_tiles(self):
+        self.session([(0.3, 0.0), (0.0, 0.3), (-0.3, 0.0)], [(0.5, 0.2), (0.2, 0.5)])
+        self.session([(0.1, 0.4), (-0.4, 0.1), (0.0, -0.4)], [(0.2, -0.5)])
+
+        # The first session's tiles 1 to 3 were overwritten; the posterior must hold the new ones
+        for tile_id in [0, 1, 2, 3]:
+            row = self.sampler.gp.F[self.sampler.gp.index[tile_id]]
+            np.testing.assert_allclose(row, self.sampler.world.latent(tile_id))
+            np.testing.assert_allclose(self.sampler.gp.coords[self.sampler.gp.index[tile_id]],
+                                       self.sampler.world.coords(tile_id))
+
+
+if __name__ == '__main__':
+    unittest.main()